@@ -0,0 +1,416 @@
+// Benchmark suite for candidate_generator.cpp.
+//
+// Synthesizes base and target info lists of a chosen size and length
+// distribution, then times every stage of the default pipeline separately
+// (load, combine, dedup, leet, output) plus end-to-end streaming and the
+// library's pull API, and writes the results as JSON so they can be tracked
+// from run to run.
+//
+//   cmake --build build --target bench                  (runs with defaults)
+//   build/candidate_generator_bench --words 50000 --info 20 --json results.json
+
+#include "../candidate_generator.cpp" // The internals, as one translation unit
+
+using namespace candgen::detail;
+
+#include <new>            // For replacing the global operator new
+#include <random>         // For the synthetic wordlist generator
+#include <sys/resource.h> // For getrusage(2) (peak RSS)
+
+// --- Allocation Counting ---
+// Every heap allocation made through operator new is counted, so each stage
+// can report allocations per candidate. The replacements allocate with malloc
+// and release with free; every deallocation form the standard library may
+// call is replaced as well, so none reaches the default (mismatched) one.
+// GCC cannot see that the pair matches once operator delete is inlined into a
+// new-expression's caller, so -Wmismatched-new-delete is silenced for the pair.
+
+static std::atomic<uint64_t> g_allocations(0);
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+#endif
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, std::align_val_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = nullptr;
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    if (posix_memalign(&memory, align, size == 0 ? 1 : size) == 0) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// --- Synthetic Input ---
+
+/**
+ * @brief Shape of a synthetic wordlist.
+ */
+struct ListSpec {
+    size_t count = 0;        // Number of lines
+    size_t min_length = 4;   // Shortest line
+    size_t max_length = 12;  // Longest line
+    bool peaked = false;     // Binomial lengths around the middle instead of uniform
+};
+
+/**
+ * @brief Writes a synthetic wordlist: mostly lowercase words with some capitals and digits.
+ * @param path Destination file.
+ * @param spec Size and length distribution.
+ * @param seed PRNG seed (the same seed always gives the same list).
+ * @return The number of bytes written, or 0 on failure.
+ */
+size_t write_synthetic_list(const std::string& path, const ListSpec& spec, uint32_t seed) {
+    std::mt19937 rng(seed);
+    const size_t span = spec.max_length - spec.min_length;
+    std::uniform_int_distribution<size_t> uniform_length(0, span);
+    std::binomial_distribution<size_t> peaked_length(span, 0.5);
+    std::uniform_int_distribution<int> letter(0, 25);
+    std::uniform_int_distribution<int> kind(0, 19);
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    size_t bytes = 0;
+    {
+        OutputWriter out(OutputWriter::k_default_buffer_size, fd);
+        std::string word;
+        for (size_t i = 0; i < spec.count; ++i) {
+            const size_t length = spec.min_length + (spec.peaked ? peaked_length(rng) : uniform_length(rng));
+            word.clear();
+            for (size_t j = 0; j < length; ++j) {
+                const int k = kind(rng);
+                if (k == 0) word.push_back(static_cast<char>('A' + letter(rng)));
+                else if (k == 1) word.push_back(static_cast<char>('0' + letter(rng) % 10));
+                else word.push_back(static_cast<char>('a' + letter(rng)));
+            }
+            out.write_line(word);
+        }
+        out.flush();
+        bytes = out.ok() ? out.bytes_written() : 0;
+    }
+    ::close(fd);
+    return bytes;
+}
+
+// --- Measurement ---
+
+/** @return The peak resident set size of the process so far, in KiB. */
+long peak_rss_kib() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * @brief Sink that only counts candidates and their bytes (no storage, no output).
+ */
+class CountingSink : public CandidateSink {
+public:
+    CountingSink() : count_(0), bytes_(0) {}
+
+    void emit(StringView candidate) override {
+        ++count_;
+        bytes_ += candidate.size() + 1;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    uint64_t count_;
+    uint64_t bytes_;
+};
+
+/**
+ * @brief Result of one timed stage.
+ */
+struct StageResult {
+    std::string name;
+    double seconds = 0.0;
+    uint64_t candidates = 0; // Candidates (or lines) processed by the stage
+    uint64_t bytes = 0;      // Bytes processed by the stage
+    uint64_t allocations = 0; // operator new calls during the stage
+    bool steady = false;      // Generation stage that must not allocate per candidate
+    long peak_rss_kib = 0;    // Process peak RSS at the end of the stage
+};
+
+/**
+ * @brief Times one stage.
+ * @param name Stage name used in the report.
+ * @param run Called as run(candidates, bytes); reports how much work it did.
+ * @param steady true for generation stages whose allocations must not grow with
+ *        the number of candidates (checked in the report).
+ */
+template <typename Run>
+StageResult time_stage(const std::string& name, Run run, bool steady = false) {
+    StageResult result;
+    result.name = name;
+    result.steady = steady;
+    std::cerr << "[*] Running stage: " << name << "..." << std::endl;
+    const uint64_t allocations_before = g_allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    run(result.candidates, result.bytes);
+    const auto stop = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(stop - start).count();
+    result.allocations = g_allocations.load() - allocations_before;
+    result.peak_rss_kib = peak_rss_kib();
+    return result;
+}
+
+/** @brief Writes s as a JSON string literal. */
+void write_json_string(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+// --- Command Line Handling ---
+
+/**
+ * @brief Benchmark settings collected from the command line.
+ */
+struct BenchOptions {
+    ListSpec base;
+    ListSpec info;
+    uint32_t seed = 1;
+    std::string work_directory = "."; // Where the synthetic lists are written
+    std::string json_path;            // "" = JSON to stdout
+    std::string cpu_features = "auto";
+    BenchOptions() {
+        base.count = 10000;
+        info.count = 10;
+        info.min_length = 3;
+        info.max_length = 10;
+    }
+};
+
+void print_bench_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --words N           Base words to synthesize (default 10000)." << std::endl;
+    std::cerr << "  --info N            Target info entries to synthesize (default 10)." << std::endl;
+    std::cerr << "  --min-length N      Shortest base word (default 4)." << std::endl;
+    std::cerr << "  --max-length N      Longest base word (default 12)." << std::endl;
+    std::cerr << "  --length-dist DIST  uniform or peaked (binomial around the middle; default uniform)." << std::endl;
+    std::cerr << "  --seed N            Seed of the synthetic lists (default 1)." << std::endl;
+    std::cerr << "  --dir DIR           Directory for the synthetic lists (default .)." << std::endl;
+    std::cerr << "  --json FILE         Write the results to FILE instead of stdout." << std::endl;
+    std::cerr << "  --cpu-features L    Kernels to measure: auto, scalar, sse2, ssse3, avx2 or avx512." << std::endl;
+}
+
+bool parse_bench_arguments(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) return false; // Every option takes a value
+        const std::string value = argv[++i];
+        unsigned long long number = 0;
+        if (arg == "--words" && parse_unsigned(value, number) && number > 0) options.base.count = number;
+        else if (arg == "--info" && parse_unsigned(value, number)) options.info.count = number;
+        else if (arg == "--min-length" && parse_unsigned(value, number) && number > 0) options.base.min_length = number;
+        else if (arg == "--max-length" && parse_unsigned(value, number) && number > 0) options.base.max_length = number;
+        else if (arg == "--length-dist" && (value == "uniform" || value == "peaked")) options.base.peaked = value == "peaked";
+        else if (arg == "--seed" && parse_unsigned(value, number)) options.seed = static_cast<uint32_t>(number);
+        else if (arg == "--dir") options.work_directory = value;
+        else if (arg == "--json") options.json_path = value;
+        else if (arg == "--cpu-features") options.cpu_features = value;
+        else return false;
+    }
+    return options.base.min_length <= options.base.max_length;
+}
+
+// --- Main Function ---
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parse_bench_arguments(argc, argv, options)) {
+        print_bench_usage(argv[0]);
+        return 1;
+    }
+    if (!select_cpu_features(options.cpu_features)) {
+        std::cerr << "Error: Unknown or unsupported --cpu-features: " << options.cpu_features << "." << std::endl;
+        return 1;
+    }
+
+    const std::string base_path = options.work_directory + "/bench_base_words.txt";
+    const std::string info_path = options.work_directory + "/bench_target_info.txt";
+    std::cerr << "[*] Synthesizing " << options.base.count << " base words and " << options.info.count
+              << " target info entries..." << std::endl;
+    if (write_synthetic_list(base_path, options.base, options.seed) == 0 ||
+        (options.info.count > 0 && write_synthetic_list(info_path, options.info, options.seed + 1) == 0)) {
+        std::cerr << "Error: Could not write the synthetic lists to " << options.work_directory << "." << std::endl;
+        return 1;
+    }
+
+    std::vector<StageResult> results;
+    const CombinatorConfig combinator;
+    const LeetTable leet_table = LeetTable::defaults();
+    Wordlist base_words;
+    Wordlist target_info;
+
+    // Load: mmap + newline scan of both lists
+    results.push_back(time_stage("load", [&](uint64_t& candidates, uint64_t& bytes) {
+        base_words.load(base_path);
+        if (options.info.count > 0) target_info.load(info_path);
+        candidates = base_words.size() + target_info.size();
+        for (StringView line : base_words) bytes += line.size() + 1;
+        for (StringView line : target_info) bytes += line.size() + 1;
+    }));
+
+    // Combine: generate_target_combinations() without storing anything
+    results.push_back(time_stage("combine", [&](uint64_t& candidates, uint64_t& bytes) {
+        CountingSink sink;
+        generate_target_combinations(base_words.lines(), target_info.lines(), combinator, sink);
+        candidates = sink.count();
+        bytes = sink.bytes();
+    }, true));
+
+    // Dedup: the same combinations inserted into the CandidateSet
+    CandidateSet candidates_set(base_words.size() * 16);
+    results.push_back(time_stage("dedup", [&](uint64_t& candidates, uint64_t& bytes) {
+        SetSink sink(candidates_set);
+        for (StringView word : base_words) candidates_set.insert(word.data(), word.size());
+        generate_target_combinations(base_words.lines(), target_info.lines(), combinator, sink);
+        candidates = candidates_set.size();
+        bytes = candidates_set.arena_size();
+    }));
+
+    // Leet: apply_leetspeak() over the unique combinations, in place
+    results.push_back(time_stage("leet", [&](uint64_t& candidates, uint64_t& bytes) {
+        CountingSink sink;
+        apply_leetspeak(candidates_set, leet_table, 1, sink);
+        candidates = sink.count();
+        bytes = sink.bytes();
+    }, true));
+
+    // Output: the set's arena through the OutputWriter into /dev/null
+    results.push_back(time_stage("output", [&](uint64_t& candidates, uint64_t& bytes) {
+        const int fd = ::open("/dev/null", O_WRONLY);
+        {
+            OutputWriter writer(OutputWriter::k_default_buffer_size, fd);
+            candidates_set.for_each([&](StringView candidate) {
+                writer.write_line(candidate.data(), candidate.size());
+            });
+            writer.flush();
+            bytes = writer.bytes_written();
+        }
+        ::close(fd);
+        candidates = candidates_set.size();
+    }));
+
+    // Macro: the whole streaming pipeline (combine + leet + nearby dedup + output)
+    results.push_back(time_stage("stream_end_to_end", [&](uint64_t& candidates, uint64_t& bytes) {
+        const int fd = ::open("/dev/null", O_WRONLY);
+        {
+            OutputWriter writer(OutputWriter::k_default_buffer_size, fd);
+            StreamSink output(writer);
+            TransformConfig transforms;
+            transforms.leet = &leet_table;
+            TransformChain chain(transforms, output);
+            generate_target_combinations(base_words.lines(), target_info.lines(), combinator, chain.input());
+            writer.flush();
+            candidates = output.emitted();
+            bytes = writer.bytes_written();
+        }
+        ::close(fd);
+    }, true));
+
+    // The same streaming run with one thread per stage (--stream --pipeline)
+    results.push_back(time_stage("stream_pipelined", [&](uint64_t& candidates, uint64_t& bytes) {
+        const int fd = ::open("/dev/null", O_WRONLY);
+        {
+            OutputWriter writer(OutputWriter::k_default_buffer_size, fd);
+            TransformConfig transforms;
+            transforms.leet = &leet_table;
+            candidates = stream_pipelined(base_words.lines(), target_info.lines(), combinator, transforms, writer);
+            writer.flush();
+            bytes = writer.bytes_written();
+        }
+        ::close(fd);
+    }, true));
+
+    // Pull: the same pipeline through the library API (candgen::Generator)
+    results.push_back(time_stage("pull", [&](uint64_t& candidates, uint64_t& bytes) {
+        candgen::Config config;
+        config.base_wordlist_path = base_path;
+        if (options.info.count > 0) config.target_info_path = info_path;
+        candgen::Generator generator(config);
+        const size_t k_batch = 4096;
+        std::vector<char> buffer(OutputWriter::k_default_buffer_size);
+        std::vector<uint32_t> offsets(k_batch + 1);
+        while (size_t count = generator.next_batch(buffer.data(), buffer.size(), offsets.data(), k_batch)) {
+            candidates += count;
+            bytes += offsets[count];
+        }
+    }, true));
+
+    // --- Report ---
+    std::ofstream file;
+    if (!options.json_path.empty()) {
+        file.open(options.json_path.c_str(), std::ios::trunc);
+        if (!file) {
+            std::cerr << "Error: Could not write " << options.json_path << "." << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& json = options.json_path.empty() ? std::cout : file;
+    json << "{\n  \"config\": {\"words\": " << options.base.count << ", \"info\": " << options.info.count
+         << ", \"min_length\": " << options.base.min_length << ", \"max_length\": " << options.base.max_length
+         << ", \"length_dist\": \"" << (options.base.peaked ? "peaked" : "uniform") << "\", \"seed\": "
+         << options.seed << ", \"cpu\": \"" << k_cpu_level_names[CpuDispatch::instance().level()] << "\"},\n  \"stages\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const StageResult& r = results[i];
+        const double seconds = r.seconds > 0.0 ? r.seconds : 1e-9;
+        json << "    {\"name\": ";
+        write_json_string(json, r.name);
+        json << ", \"seconds\": " << r.seconds
+             << ", \"candidates\": " << r.candidates
+             << ", \"bytes\": " << r.bytes
+             << ", \"candidates_per_second\": " << static_cast<uint64_t>(r.candidates / seconds)
+             << ", \"bytes_per_second\": " << static_cast<uint64_t>(r.bytes / seconds)
+             << ", \"allocations\": " << r.allocations
+             << ", \"allocations_per_candidate\": "
+             << (r.candidates > 0 ? static_cast<double>(r.allocations) / r.candidates : 0.0)
+             << ", \"peak_rss_kib\": " << r.peak_rss_kib << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        std::cerr << "[*] " << r.name << ": " << r.seconds << " s, " << static_cast<uint64_t>(r.candidates / seconds)
+                  << " candidates/s, " << r.allocations << " allocations" << std::endl;
+    }
+    json << "  ]\n}" << std::endl;
+
+    // Generation must not allocate in the steady state: a stage's allocations
+    // (setup only) have to stay far below one per thousand candidates
+    int status = 0;
+    for (const StageResult& r : results) {
+        if (r.steady && r.allocations * 1000 > r.candidates) {
+            std::cerr << "Error: Stage " << r.name << " made " << r.allocations << " allocations for "
+                      << r.candidates << " candidates." << std::endl;
+            status = 1;
+        }
+    }
+
+    std::remove(base_path.c_str());
+    std::remove(info_path.c_str());
+    return status;
+}
@@ -0,0 +1,144 @@
+// libcandgen: the candidate generator as a library.
+//
+// A Generator loads the inputs once and then hands out candidates on demand,
+// packed into buffers owned by the caller, in keyspace order (the order of
+// `candidate_generator --stream --ordered`):
+//
+//   candgen::Config config;
+//   config.base_wordlist_path = "common_words.txt";
+//   config.target_info_path = "company_info.txt";
+//   candgen::Generator generator(config);
+//
+//   std::vector<char> buffer(1 << 20);
+//   std::vector<uint32_t> offsets(4096 + 1);
+//   while (size_t n = generator.next_batch(buffer.data(), buffer.size(), offsets.data(), 4096)) {
+//       for (size_t i = 0; i < n; ++i) {
+//           // Candidate i: buffer[offsets[i]] .. buffer[offsets[i + 1] - 2], then '\n'
+//       }
+//   }
+//
+// Build with CMake (target `candgen`) or compile candidate_generator.cpp into
+// your program. Everything but this interface is in namespace candgen::detail.
+
+#ifndef CANDGEN_H
+#define CANDGEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace candgen {
+
+/**
+ * @brief How a Generator removes repeated candidates.
+ */
+enum DedupMode {
+    DEDUP_NONE,   // Every keyspace position that is not a hole (like --skip/--limit)
+    DEDUP_RECENT, // Nearby repeats only, in constant memory (like --stream)
+    DEDUP_APPROX, // Fixed-size Bloom filter; may drop a tiny fraction (like --dedup approx)
+    DEDUP_EXACT   // Every candidate is remembered; memory grows with the output
+};
+
+/** @brief Longest candidate any strategy produces, in bytes (hashcat's limit). */
+const size_t k_max_candidate_length = 256;
+
+/** @brief Smallest buffer Generator::next_batch() accepts: one longest candidate and its newline. */
+const size_t k_min_batch_capacity = k_max_candidate_length + 1;
+
+/** @brief Largest Config::leet_max_variants: every form of a word with 24 substitutable characters. */
+const size_t k_max_leet_variants = static_cast<size_t>(1) << 24;
+
+/**
+ * @brief Inputs and strategy settings of a Generator.
+ */
+struct Config {
+    std::string base_wordlist_path;       // Base wordlist file ("" = use base_words)
+    std::string target_info_path;         // Target info file ("" = use target_info)
+    std::vector<std::string> base_words;  // In-memory base words (when no path is given)
+    std::vector<std::string> target_info; // In-memory target info (when no path is given)
+    std::string case_forms = "cap";       // Comma-separated lower, cap, upper, toggle, or none
+    std::string rules_path;               // hashcat/JtR rule file ("" = no rules)
+    std::string leet_table_path;          // Leetspeak substitution table ("" = built-in)
+    bool leet_all = false;                // Enumerate partial leetspeak forms too
+    size_t leet_max_variants = 256;       // Per-word cap on leetspeak variants when leet_all is set (1 to k_max_leet_variants)
+    std::vector<std::string> exclude_paths; // Wordlists/potfiles whose entries are never emitted
+    unsigned shard_index = 0;             // Zero-based shard of the base words to generate
+    unsigned shard_count = 1;             // Number of shards the base words are split into
+    DedupMode dedup = DEDUP_RECENT;       // Repeat removal (see DedupMode)
+    size_t dedup_memory = 512 << 20;      // Bloom filter bytes for DEDUP_APPROX
+    std::ostream* log = nullptr;          // Receives "[*] Loading ..." messages (nullptr = quiet)
+};
+
+/**
+ * @brief Pull-style candidate source.
+ * All candidates of the configured strategies are numbered by a keyspace
+ * position; the generator walks the positions in order and fills each batch
+ * without allocating per candidate. Not thread-safe: use one Generator (or one
+ * shard) per thread.
+ */
+class Generator {
+public:
+    /**
+     * @brief Loads the inputs and compiles the rules, leetspeak table and exclusions.
+     * @throws std::invalid_argument for an invalid setting.
+     * @throws std::runtime_error if an input cannot be used (e.g. empty base wordlist).
+     */
+    explicit Generator(const Config& config);
+    ~Generator();
+
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    /**
+     * @brief Fills buffer with the next candidates, each terminated by '\n'.
+     * @param buffer Destination bytes.
+     * @param capacity Size of buffer, at least k_min_batch_capacity; a candidate
+     *        that does not fit is kept for the next call.
+     * @param offsets Receives count + 1 entries: candidate i occupies
+     *        [offsets[i], offsets[i + 1]) including its newline, and
+     *        offsets[count] is the number of bytes used.
+     * @param max_count Maximum candidates to return, at least 1 (offsets must hold
+     *        max_count + 1 entries).
+     * @return The number of candidates written; 0 only once the range is exhausted.
+     * @throws std::invalid_argument if capacity or max_count is too small to make progress.
+     */
+    size_t next_batch(char* buffer, size_t capacity, uint32_t* offsets, size_t max_count);
+
+    /** @return The number of keyspace positions (0 if it exceeds 2^64 - 1). */
+    uint64_t keyspace_size() const;
+
+    /**
+     * @brief Restricts generation to the positions [first, last) and starts at first.
+     * Ranges of disjoint generators concatenate to the whole keyspace; with
+     * DEDUP_NONE the output is the same as `--skip first --limit (last - first)`.
+     */
+    void set_range(uint64_t first, uint64_t last);
+
+    /** @return The next keyspace position to be examined (resume point). */
+    uint64_t position() const;
+
+    /** @return true once every position of the range has been returned. */
+    bool done() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/**
+ * @brief Selects the instruction set of the vectorised kernels for the whole process.
+ * Call it before any Generator is in use; by default the best one the CPU supports is used.
+ * @param name "auto", "scalar", "sse2", "ssse3", "avx2" or "avx512".
+ * @return false if the name is unknown or the CPU lacks that instruction set.
+ */
+bool set_cpu_features(const std::string& name);
+
+/** @return The instruction set the kernels currently use (e.g. "avx2"). */
+std::string cpu_features();
+
+} // namespace candgen
+
+#endif // CANDGEN_H
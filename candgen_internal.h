@@ -0,0 +1,77 @@
+// Internal interface between libcandgen and the candidate_generator tool.
+//
+// The command line tool (candidate_generator_cli.cpp) parses its arguments
+// into an Options and hands it to run(), which lives in the library next to
+// the internals it drives. Not installed: embedders use candgen.h.
+
+#ifndef CANDGEN_INTERNAL_H
+#define CANDGEN_INTERNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "candgen.h"
+
+namespace candgen {
+namespace detail {
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    candgen::Config generator;      // Inputs and strategies (paths, case forms, rules, leetspeak, shard, exclusions)
+    bool stream = false;            // Emit candidates as they are produced (bounded memory)
+    size_t output_buffer_size = 1 << 20; // Bytes per write(2) (OutputWriter's default)
+    unsigned threads = 1;           // Generation threads (0 = one per core)
+    bool ordered = false;           // Deterministic output order in threaded streaming mode
+    bool pipeline = false;          // One thread per stage, connected by SPSC batch queues
+    bool probability_order = false; // Emit the most likely candidates first
+    std::string weights_path;       // Scoring weights to load ("" = built-in defaults)
+    std::string train_path;         // Password list to learn the weights from ("" = don't)
+    std::string save_weights_path;  // Write the final weights here ("" = don't)
+    uint64_t top = 0;               // Stop after this many candidates (0 = all)
+    std::string pcfg_path;          // Generate from this binary grammar ("" = no PCFG)
+    std::string pcfg_train_path;    // Password list to learn a grammar from ("" = don't)
+    std::string pcfg_save_path;     // Write the learned grammar here and exit ("" = don't)
+    bool markov = false;            // Enumerate Markov strings learned from the input lists
+    unsigned markov_order = 2;      // Characters of context per transition
+    unsigned markov_level = 20;     // Highest level (probability threshold) enumerated
+    bool keyspace = false;          // Print the keyspace size and exit
+    bool keyspace_range = false;    // Enumerate keyspace positions (--skip/--limit given)
+    uint64_t skip = 0;              // First keyspace position to emit
+    uint64_t limit = 0;             // Number of keyspace positions to emit (0 = to the end)
+    std::string checkpoint_path;    // Checkpoint file for keyspace runs ("" = no checkpoints)
+    bool restore = false;           // Resume from checkpoint_path
+    unsigned checkpoint_interval = 30; // Seconds between periodic checkpoints
+    bool approx_dedup = false;      // De-duplicate with a Bloom filter instead of the candidate set
+    size_t dedup_memory = 512 << 20; // Bloom filter budget in bytes
+    std::string spill_directory;    // Directory for sorted runs ("" = keep everything in memory)
+    size_t spill_memory = static_cast<size_t>(1) << 30; // In-memory run budget in bytes
+    unsigned progress_interval = 0; // Seconds between progress lines on stderr (0 = off)
+    std::string stats_json_path;    // Write counters and phase timers here at exit ("" = don't)
+    std::string cpu_features = "auto"; // Instruction set of the vectorised kernels
+};
+
+/** @brief Parses a non-negative decimal integer option value. @return true if the whole text was a valid number. */
+bool parse_unsigned(const std::string& text, unsigned long long& value);
+
+/** @brief Parses a byte count with an optional K/M/G/T suffix. @return true if the text was a valid non-zero size that fits in size_t. */
+bool parse_size(const std::string& text, size_t& value);
+
+/** @return true if text is a valid --case list (lower, cap, upper, toggle, or none). */
+bool valid_case_forms(const std::string& text);
+
+extern const unsigned k_markov_max_order; // Highest --markov-order
+extern const unsigned k_markov_max_level; // Highest --markov-level
+
+/**
+ * @brief Runs the mode the options select and writes its candidates to stdout.
+ * @return The process exit status.
+ */
+int run(const Options& options);
+
+} // namespace detail
+} // namespace candgen
+
+#endif // CANDGEN_INTERNAL_H
@@ -1,265 +1,6151 @@
 #include <iostream> // For standard I/O (cout, cerr, endl)
 #include <string>   // For using std::string
 #include <vector>   // For using std::vector
-#include <fstream>  // For file stream operations (ifstream)
-#include <sstream>  // For string stream operations (though not strictly needed in this version)
+#include <sstream>  // For string stream operations (splitting option lists)
 #include <algorithm> // For algorithms like std::transform, std::replace, std::all_of
-#include <set>      // For using std::set to store unique candidates
 #include <cctype>   // For character handling functions (isprint, toupper)
 #include <stdexcept> // For standard exceptions (though not used here, good practice for future)
+#include <cstdint>  // For fixed-width integers (uint64_t) used by hashing and the candidate set
+#include <cstring>  // For std::memcpy / std::memcmp
+#include <cstdlib>  // For posix_memalign / free, strtoull
+#include <cerrno>   // For errno (EINTR handling in the output writer)
+#include <unistd.h> // For write(2), read(2), close(2) and STDOUT_FILENO
+#include <fcntl.h>  // For open(2)
+#include <sys/mman.h> // For mmap(2) / madvise(2) in the wordlist loader
+#include <sys/stat.h> // For fstat(2)
+#include <thread>   // For std::thread (parallel generation)
+#include <mutex>    // For std::mutex guarding the shared output writer
+#include <condition_variable> // For ordering chunk output between worker threads
+#include <atomic>   // For the shared chunk counter
+#include <memory>   // For std::unique_ptr
+#include <fstream>  // For reading and writing checkpoint files
+#include <cstdio>   // For std::rename (atomic checkpoint replacement)
+#include <csignal>  // For SIGINT/SIGTERM/SIGPIPE handling in checkpoint mode
+#include <signal.h> // For sigaction(2) (stop handler without SA_RESTART)
+#include <chrono>   // For the checkpoint interval
+#include <cmath>    // For std::exp/std::log (Bloom filter sizing)
+#include <ctime>    // For std::clock (CPU time of instrumented phases)
+#include <queue>    // For std::priority_queue (probability-ordered enumeration)
+#include <map>      // For per-suffix scoring weights
+#include <unordered_map> // For base word counts learned from a training list
+#include <unordered_set> // For the distinct PCFG fillers and grammar group keys
+#include <functional> // For std::function (BufferSink's drain hook)
+#include "candgen.h" // Public library interface (candgen::Generator)
+#include "candgen_internal.h" // Interface of the command line tool (candgen::detail::run)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h> // SSE2 to AVX-512 intrinsics (dispatched kernels)
+#endif
+#if !defined(__SIZEOF_INT128__) && defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h> // For __umulh (mul_high64 without a 128-bit integer type)
+#endif
 
-// --- Helper Function ---
+namespace candgen {
+namespace detail {
+
+// --- CPU Dispatch ---
+// The byte-level hot loops (printable check, newline scanning, leetspeak
+// translation) are compiled for several instruction sets with target
+// attributes, so a binary built with plain -O2 still uses AVX2 or AVX-512
+// where the CPU has them. The best supported variant is chosen once at
+// startup from cpuid; --cpu-features overrides the choice for testing.
+// hash_bytes() is deliberately not dispatched: checkpoints and shards rely
+// on identical hashes on every machine, and its serial multiply chain over
+// short candidates gains nothing from wider vectors.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CANDGEN_X86_KERNELS 1
+#endif
+
+/**
+ * @brief Instruction sets the kernels are built for, in increasing order.
+ */
+enum CpuLevel {
+    CPU_SCALAR, // Portable C++
+    CPU_SSE2,   // x86-64 baseline
+    CPU_SSSE3,  // pshufb (leetspeak translation)
+    CPU_AVX2,   // 32-byte vectors
+    CPU_AVX512, // 64-byte vectors and masked tails (AVX-512BW)
+    CPU_LEVEL_COUNT
+};
+
+const char* const k_cpu_level_names[CPU_LEVEL_COUNT] = {"scalar", "sse2", "ssse3", "avx2", "avx512"};
+
+/**
+ * @brief The kernel variants of one instruction set.
+ */
+struct CpuKernels {
+    /** @brief true if every byte is printable ASCII (0x20-0x7E, like isprint in the C locale). */
+    bool (*printable)(const char* data, size_t size);
+    /**
+     * @brief Stores the offset of every '\n' in data[0, size) into positions.
+     * @return The number of newlines found.
+     */
+    size_t (*find_newlines)(const char* data, size_t size, uint32_t* positions);
+    /**
+     * @brief Maps size bytes through a 256-entry table (in and out may be identical).
+     * Only the 16-entry rows listed in rows contain substitutions.
+     * @return true if at least one byte changed.
+     */
+    bool (*translate)(const uint8_t* table, const uint8_t* rows, size_t row_count,
+                      const uint8_t* in, uint8_t* out, size_t size);
+};
+
+// Scalar kernels (also the tails of the vector ones)
+
+inline bool is_printable_byte(uint8_t c) { return static_cast<uint8_t>(c - 0x20) < 0x5F; }
+
+bool printable_scalar(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (!is_printable_byte(static_cast<uint8_t>(data[i]))) return false;
+    }
+    return true;
+}
+
+size_t find_newlines_scalar(const char* data, size_t size, uint32_t* positions) {
+    size_t count = 0;
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (nl == nullptr) break;
+        positions[count++] = static_cast<uint32_t>(nl - data);
+        p = nl + 1;
+    }
+    return count;
+}
+
+bool translate_scalar(const uint8_t* table, const uint8_t*, size_t, const uint8_t* in, uint8_t* out, size_t size) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const uint8_t c = table[in[i]];
+        diff |= static_cast<uint8_t>(c ^ in[i]);
+        out[i] = c;
+    }
+    return diff != 0;
+}
+
+#if defined(CANDGEN_X86_KERNELS)
+// Each kernel walks full vectors and leaves the remainder to the scalar code,
+// except the AVX-512 ones, which finish with one masked vector. The AVX2
+// kernels hand their tail to the SSE ones; GCC turns that into a tail jump
+// without vzeroupper, so they clear the upper halves themselves (otherwise the
+// legacy-SSE code pays a false dependency on every instruction).
+
+__attribute__((target("sse2")))
+bool printable_sse2(const char* data, size_t size) {
+    const __m128i offset = _mm_set1_epi8(0x20);
+    const __m128i limit = _mm_set1_epi8(0x5E);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        // Printable iff byte - 0x20 <= 0x5E (unsigned)
+        const __m128i shifted = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), offset);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(shifted, limit), shifted)) != 0xFFFF) return false;
+    }
+    return printable_scalar(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+bool printable_avx2(const char* data, size_t size) {
+    const __m256i offset = _mm256_set1_epi8(0x20);
+    const __m256i limit = _mm256_set1_epi8(0x5E);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i shifted =
+            _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), offset);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(shifted, limit), shifted)) != -1) return false;
+    }
+    _mm256_zeroupper();
+    return printable_sse2(data + i, size - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+bool printable_avx512(const char* data, size_t size) {
+    const __m512i offset = _mm512_set1_epi8(0x20);
+    const __m512i limit = _mm512_set1_epi8(0x5F);
+    for (size_t i = 0; i < size; i += 64) {
+        const size_t n = std::min<size_t>(64, size - i);
+        const __mmask64 lanes = n == 64 ? ~0ULL : (1ULL << n) - 1;
+        const __m512i shifted = _mm512_sub_epi8(_mm512_maskz_loadu_epi8(lanes, data + i), offset);
+        if (_mm512_mask_cmplt_epu8_mask(lanes, shifted, limit) != lanes) return false;
+    }
+    return true;
+}
+
+__attribute__((target("sse2")))
+size_t find_newlines_sse2(const char* data, size_t size, uint32_t* positions) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lo, newline))) |
+                        (static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hi, newline))) << 16);
+        for (; mask != 0; mask &= mask - 1) positions[count++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+    }
+    const size_t tail = find_newlines_scalar(data + i, size - i, positions + count);
+    for (size_t t = count; t < count + tail; ++t) positions[t] += static_cast<uint32_t>(i);
+    return count + tail;
+}
+
+__attribute__((target("avx2")))
+size_t find_newlines_avx2(const char* data, size_t size, uint32_t* positions) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+        for (; mask != 0; mask &= mask - 1) positions[count++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+    }
+    const size_t tail = find_newlines_scalar(data + i, size - i, positions + count);
+    for (size_t t = count; t < count + tail; ++t) positions[t] += static_cast<uint32_t>(i);
+    return count + tail;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+size_t find_newlines_avx512(const char* data, size_t size, uint32_t* positions) {
+    const __m512i newline = _mm512_set1_epi8('\n');
+    size_t count = 0;
+    for (size_t i = 0; i < size; i += 64) {
+        const size_t n = std::min<size_t>(64, size - i);
+        const __mmask64 lanes = n == 64 ? ~0ULL : (1ULL << n) - 1;
+        uint64_t mask = _mm512_mask_cmpeq_epi8_mask(lanes, _mm512_maskz_loadu_epi8(lanes, data + i), newline);
+        for (; mask != 0; mask &= mask - 1) positions[count++] = static_cast<uint32_t>(i + __builtin_ctzll(mask));
+    }
+    return count;
+}
+
+// Leetspeak translation: each byte selects a table row by its high nibble and
+// an entry by its low nibble (pshufb); only rows holding substitutions are
+// looked up, and their results are blended over the input.
+
+__attribute__((target("ssse3")))
+bool translate_ssse3(const uint8_t* table, const uint8_t* rows, size_t row_count,
+                     const uint8_t* in, uint8_t* out, size_t size) {
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    __m128i diff = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i lo = _mm_and_si128(block, low_mask);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(block, 4), low_mask);
+        __m128i result = block;
+        for (size_t r = 0; r < row_count; ++r) {
+            const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + rows[r] * 16));
+            const __m128i select = _mm_cmpeq_epi8(hi, _mm_set1_epi8(static_cast<char>(rows[r])));
+            // Blend without SSE4.1: (select & mapped) | (~select & result)
+            result = _mm_or_si128(_mm_and_si128(select, _mm_shuffle_epi8(lut, lo)), _mm_andnot_si128(select, result));
+        }
+        diff = _mm_or_si128(diff, _mm_xor_si128(result, block));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+    const bool changed = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF;
+    return translate_scalar(table, rows, row_count, in + i, out + i, size - i) || changed;
+}
+
+__attribute__((target("avx2")))
+bool translate_avx2(const uint8_t* table, const uint8_t* rows, size_t row_count,
+                    const uint8_t* in, uint8_t* out, size_t size) {
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    __m256i diff = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i lo = _mm256_and_si256(block, low_mask);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), low_mask);
+        __m256i result = block;
+        for (size_t r = 0; r < row_count; ++r) {
+            const __m256i lut = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + rows[r] * 16)));
+            const __m256i select = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(static_cast<char>(rows[r])));
+            result = _mm256_blendv_epi8(result, _mm256_shuffle_epi8(lut, lo), select);
+        }
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(result, block));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+    }
+    const bool changed = !_mm256_testz_si256(diff, diff);
+    _mm256_zeroupper();
+    return translate_ssse3(table, rows, row_count, in + i, out + i, size - i) || changed;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+bool translate_avx512(const uint8_t* table, const uint8_t* rows, size_t row_count,
+                      const uint8_t* in, uint8_t* out, size_t size) {
+    const __m512i low_mask = _mm512_set1_epi8(0x0F);
+    __mmask64 changed = 0;
+    for (size_t i = 0; i < size; i += 64) {
+        const size_t n = std::min<size_t>(64, size - i);
+        const __mmask64 lanes = n == 64 ? ~0ULL : (1ULL << n) - 1;
+        const __m512i block = _mm512_maskz_loadu_epi8(lanes, in + i);
+        const __m512i lo = _mm512_and_si512(block, low_mask);
+        const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(block, 4), low_mask);
+        __m512i result = block;
+        for (size_t r = 0; r < row_count; ++r) {
+            const __m512i lut = _mm512_maskz_broadcast_i32x4( // (maskz form: no undefined upper lanes)
+                0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + rows[r] * 16)));
+            const __mmask64 select = _mm512_cmpeq_epi8_mask(hi, _mm512_set1_epi8(static_cast<char>(rows[r])));
+            result = _mm512_mask_blend_epi8(select, result, _mm512_shuffle_epi8(lut, lo));
+        }
+        changed |= _mm512_mask_cmpneq_epi8_mask(lanes, result, block);
+        _mm512_mask_storeu_epi8(out + i, lanes, result);
+    }
+    return changed != 0;
+}
+#endif // CANDGEN_X86_KERNELS
+
+/**
+ * @return The best instruction set both the CPU and the operating system support.
+ */
+CpuLevel detect_cpu_level() {
+#if defined(CANDGEN_X86_KERNELS)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return CPU_AVX512;
+    if (__builtin_cpu_supports("avx2")) return CPU_AVX2;
+    if (__builtin_cpu_supports("ssse3")) return CPU_SSSE3;
+    if (__builtin_cpu_supports("sse2")) return CPU_SSE2;
+#endif
+    return CPU_SCALAR;
+}
+
+/**
+ * @brief The kernels in use, process-wide.
+ * Starts at the detected level; select_cpu_level() switches it, which must
+ * happen before any worker thread starts.
+ */
+class CpuDispatch {
+public:
+    static CpuDispatch& instance() {
+        static CpuDispatch dispatch;
+        return dispatch;
+    }
+
+    const CpuKernels& kernels() const { return kernels_; }
+    CpuLevel level() const { return level_; }
+    CpuLevel detected() const { return detected_; }
+
+    /**
+     * @brief Switches to the kernels of level.
+     * @return false if the CPU does not support level (nothing changes).
+     */
+    bool select(CpuLevel level) {
+        if (level > detected_) return false;
+        level_ = level;
+        kernels_.printable = printable_scalar;
+        kernels_.find_newlines = find_newlines_scalar;
+        kernels_.translate = translate_scalar;
+#if defined(CANDGEN_X86_KERNELS)
+        switch (level) {
+        case CPU_AVX512:
+            kernels_.printable = printable_avx512;
+            kernels_.find_newlines = find_newlines_avx512;
+            kernels_.translate = translate_avx512;
+            break;
+        case CPU_AVX2:
+            kernels_.printable = printable_avx2;
+            kernels_.find_newlines = find_newlines_avx2;
+            kernels_.translate = translate_avx2;
+            break;
+        case CPU_SSSE3:
+            kernels_.printable = printable_sse2;
+            kernels_.find_newlines = find_newlines_sse2;
+            kernels_.translate = translate_ssse3;
+            break;
+        case CPU_SSE2:
+            kernels_.printable = printable_sse2;
+            kernels_.find_newlines = find_newlines_sse2;
+            break;
+        default:
+            break;
+        }
+#endif
+        return true;
+    }
+
+private:
+    CpuDispatch() : detected_(detect_cpu_level()) { select(detected_); }
+
+    CpuKernels kernels_;
+    CpuLevel level_;
+    CpuLevel detected_;
+};
+
+/** @return The kernels selected for this process. */
+inline const CpuKernels& cpu_kernels() { return CpuDispatch::instance().kernels(); }
+
+/**
+ * @brief Selects the kernels by name: "auto" (the detected level) or a CpuLevel name.
+ * @return false if the name is unknown or the CPU lacks that instruction set.
+ */
+bool select_cpu_features(const std::string& name) {
+    CpuDispatch& dispatch = CpuDispatch::instance();
+    if (name == "auto") return dispatch.select(dispatch.detected());
+    for (int level = 0; level < CPU_LEVEL_COUNT; ++level) {
+        if (name == k_cpu_level_names[level]) return dispatch.select(static_cast<CpuLevel>(level));
+    }
+    return false;
+}
+
+// --- Helper Functions ---
+
+/**
+ * @brief Checks if all characters in a string are printable ASCII characters.
+ * Helps filter out potentially problematic binary data read from files.
+ * @param s The string to check.
+ * @return true if all characters are printable, false otherwise.
+ */
+bool is_printable(const std::string& s) {
+    // Vectorised range check, equivalent to std::isprint in the C locale
+    return cpu_kernels().printable(s.data(), s.size());
+}
+
+/**
+ * @brief Non-owning reference to a run of characters (like C++17 std::string_view).
+ * Used to hand out candidates stored inside larger buffers without copying them.
+ */
+class StringView {
+public:
+    StringView() : data_(nullptr), size_(0) {}
+    StringView(const char* data, size_t size) : data_(data), size_(size) {}
+    StringView(const std::string& s) : data_(s.data()), size_(s.size()) {} // Implicit, like string_view
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    char operator[](size_t i) const { return data_[i]; }
+
+    /** @return An owning copy of the referenced characters. */
+    std::string str() const { return std::string(data_, size_); }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+/**
+ * @brief StringView overload of is_printable().
+ */
+bool is_printable(StringView s) { return cpu_kernels().printable(s.data(), s.size()); }
+
+/**
+ * @brief Fixed-capacity buffer in which candidates are assembled with memcpy.
+ * Candidates are capped at k_capacity bytes, the limit of the rule engine and
+ * of hashcat itself; composing anything longer fails and the generators skip
+ * that candidate. The storage is inline, so a buffer on the stack or inside a
+ * sink never touches the heap.
+ */
+class CandidateBuffer {
+public:
+    static const size_t k_capacity = 256;
+
+    CandidateBuffer() : size_(0) {}
+
+    /** @brief Replaces the contents with a. @return false if a is longer than k_capacity. */
+    bool assign(StringView a) {
+        size_ = 0;
+        return append(a);
+    }
+    /** @brief Replaces the contents with a + b. @return false if the result would not fit. */
+    bool assign(StringView a, StringView b) {
+        size_ = 0;
+        return append(a) && append(b);
+    }
+    /** @brief Replaces the contents with a + b + c. @return false if the result would not fit. */
+    bool assign(StringView a, StringView b, StringView c) {
+        size_ = 0;
+        return append(a) && append(b) && append(c);
+    }
+
+    /** @brief Appends a. @return false (contents unchanged) if the result would not fit. */
+    bool append(StringView a) {
+        if (a.size() > k_capacity - size_) return false;
+        std::memcpy(data_ + size_, a.data(), a.size());
+        size_ += a.size();
+        return true;
+    }
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    StringView view() const { return StringView(data_, size_); }
+
+private:
+    char data_[k_capacity];
+    size_t size_;
+};
+
+/**
+ * @brief Computes a 64-bit hash of a byte range.
+ * Consumes 8 bytes per step, pre-mixing each word with a multiply/xor-shift
+ * before folding it into the state (MurmurHash64A style), and finishes with the
+ * MurmurHash3 avalanche. Pre-mixing matters: a bare multiply only carries
+ * differences towards the high bits, so two short words could cancel out and
+ * collide, which the hash-only RecentFilter would turn into a dropped candidate.
+ * @param data Pointer to the first byte.
+ * @param size Number of bytes to hash.
+ * @return The 64-bit hash value.
+ */
+uint64_t hash_bytes(const char* data, size_t size) {
+    const uint64_t k_mul = 0xC6A4A7935BD1E995ULL;
+    uint64_t h = 0x2545F4914F6CDD1DULL ^ (size * k_mul);
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8); // memcpy keeps unaligned loads well-defined
+        word *= k_mul;
+        word ^= word >> 47;
+        word *= k_mul;
+        h = (h ^ word) * k_mul;
+        data += 8;
+        size -= 8;
+    }
+    if (size > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, size);
+        h = (h ^ word) * k_mul;
+    }
+    // MurmurHash3 fmix64 finalizer
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief High 64 bits of the 128-bit product a * b, from four 32-bit partial products.
+ * The portable fallback of mul_high64(); always compiled so the tests can check it.
+ */
+inline uint64_t mul_high64_split(uint64_t a, uint64_t b) {
+    const uint64_t a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32;
+    const uint64_t b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo;
+    const uint64_t hi_lo = a_hi * b_lo;
+    const uint64_t lo_hi = a_lo * b_hi;
+    // Middle column: at most 2 * (2^32 - 1) + (2^32 - 1)^2 = 2^64 - 1, so no carry is lost
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+    return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+}
+
+/**
+ * @brief High 64 bits of the 128-bit product a * b.
+ * (mul_high64(h, n) maps a uniform hash h onto [0, n) without a division.)
+ * Uses the compiler's 128-bit integer where there is one, the MSVC intrinsic
+ * on 64-bit Windows targets, and mul_high64_split() otherwise.
+ */
+inline uint64_t mul_high64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    return __umulh(a, b);
+#else
+    return mul_high64_split(a, b);
+#endif
+}
+
+// --- Instrumentation ---
+
+/**
+ * @brief Pipeline stages with their own counters.
+ */
+enum StatStage {
+    STAT_COMBINE, // Combinations (and base words) produced
+    STAT_LEET,    // Leetspeak variants produced
+    STAT_RULES,   // Rule outputs produced / rule rejections
+    STAT_EXCLUDE, // Candidates dropped by --exclude
+    STAT_DEDUP,   // Unique candidates kept / duplicates rejected
+    STAT_OUTPUT,  // Candidates and bytes written to stdout
+    STAT_STAGE_COUNT
+};
+
+const char* const k_stat_stage_names[STAT_STAGE_COUNT] = {
+    "combine", "leet", "rules", "exclude", "dedup", "output"};
+
+/**
+ * @brief Counters owned by one thread.
+ * Only the owning thread writes them, so an increment is a plain relaxed
+ * load/add/store (no locked instruction, no shared cache line); other
+ * threads may read them at any time to aggregate.
+ */
+struct ThreadStats {
+    struct Counters {
+        std::atomic<uint64_t> produced;
+        std::atomic<uint64_t> rejected;
+        std::atomic<uint64_t> bytes;
+        Counters() : produced(0), rejected(0), bytes(0) {}
+    };
+
+    Counters stages[STAT_STAGE_COUNT];
+    std::atomic<uint64_t> progress; // Work units done (base words or keyspace positions)
+
+    ThreadStats() : progress(0) {}
+
+    /** @brief Adds n to a counter of this thread. */
+    static void add(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /** @brief Counts candidates handed to the OutputWriter. */
+    void add_output(uint64_t lines, uint64_t bytes) {
+        add(stages[STAT_OUTPUT].produced, lines);
+        add(stages[STAT_OUTPUT].bytes, bytes);
+    }
+};
+
+/**
+ * @brief Aggregated view of every thread's counters.
+ */
+struct StatTotals {
+    uint64_t produced[STAT_STAGE_COUNT] = {};
+    uint64_t rejected[STAT_STAGE_COUNT] = {};
+    uint64_t bytes[STAT_STAGE_COUNT] = {};
+    uint64_t progress = 0;
+};
+
+/**
+ * @brief Process-wide registry of thread counters and phase timers.
+ * Each thread gets its own ThreadStats on first use; blocks outlive their
+ * threads so finished workers still count in the totals.
+ */
+class Stats {
+public:
+    /** @brief Wall and CPU time of one phase of main(). */
+    struct Phase {
+        std::string name;
+        double wall_seconds;
+        double cpu_seconds; // All threads
+    };
+
+    static Stats& global() {
+        static Stats stats;
+        return stats;
+    }
+
+    /** @return The calling thread's counters. */
+    static ThreadStats& local() {
+        static thread_local ThreadStats* block = nullptr;
+        if (block == nullptr) block = global().register_thread();
+        return *block;
+    }
+
+    /** @return The sum of all threads' counters. */
+    StatTotals totals() {
+        StatTotals totals;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::unique_ptr<ThreadStats>& block : blocks_) {
+            for (int s = 0; s < STAT_STAGE_COUNT; ++s) {
+                totals.produced[s] += block->stages[s].produced.load(std::memory_order_relaxed);
+                totals.rejected[s] += block->stages[s].rejected.load(std::memory_order_relaxed);
+                totals.bytes[s] += block->stages[s].bytes.load(std::memory_order_relaxed);
+            }
+            totals.progress += block->progress.load(std::memory_order_relaxed);
+        }
+        return totals;
+    }
+
+    /**
+     * @brief Sets the amount of work the progress line measures against.
+     * @param total Total work units.
+     * @param unit Name of a unit, e.g. "base words".
+     */
+    void set_progress_total(uint64_t total, const std::string& unit) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_total_ = total;
+        progress_unit_ = unit;
+    }
+
+    /** @brief Starts timing a phase (ending the current one, if any). */
+    void begin_phase(const std::string& name) {
+        end_phase();
+        std::lock_guard<std::mutex> lock(mutex_);
+        phase_name_ = name;
+        phase_wall_ = std::chrono::steady_clock::now();
+        phase_cpu_ = std::clock();
+    }
+
+    /** @brief Records the current phase's times. */
+    void end_phase() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (phase_name_.empty()) return;
+        Phase phase;
+        phase.name = phase_name_;
+        phase.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - phase_wall_).count();
+        phase.cpu_seconds = static_cast<double>(std::clock() - phase_cpu_) / CLOCKS_PER_SEC;
+        phases_.push_back(phase);
+        phase_name_.clear();
+    }
+
+    /** @brief Prints one progress line (phase, percentage, rate, ETA) to stderr. */
+    void print_progress() {
+        const StatTotals t = totals();
+        std::string phase;
+        std::string unit;
+        uint64_t total = 0;
+        double elapsed = 0.0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            phase = phase_name_.empty() ? "done" : phase_name_;
+            unit = progress_unit_;
+            total = progress_total_;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+        const uint64_t generated = t.produced[STAT_COMBINE] + t.produced[STAT_LEET] + t.produced[STAT_RULES];
+        std::ostringstream line;
+        line << "[*] Progress (" << phase << "): ";
+        if (total > 0) {
+            const uint64_t done = std::min(t.progress, total);
+            line << std::fixed;
+            line.precision(1);
+            line << (100.0 * done / total) << "% of " << total << " " << unit << ", ";
+            if (done > 0 && done < total) {
+                line << "ETA " << format_duration(elapsed * (total - done) / done) << ", ";
+            }
+        }
+        line << format_count(generated) << " generated ("
+             << format_count(elapsed > 0.0 ? generated / elapsed : 0.0) << "/s), "
+             << format_count(t.produced[STAT_OUTPUT]) << " written";
+        std::cerr << line.str() << std::endl;
+    }
+
+    /**
+     * @brief Writes all counters and phase timers as JSON.
+     * @return false if the file cannot be written.
+     */
+    bool write_json(const std::string& path) {
+        end_phase();
+        const StatTotals t = totals();
+        std::ofstream file(path.c_str(), std::ios::trunc);
+        if (!file) return false;
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        file << "{\n  \"wall_seconds\": " << elapsed
+             << ",\n  \"cpu_seconds\": " << static_cast<double>(std::clock()) / CLOCKS_PER_SEC
+             << ",\n  \"threads\": " << blocks_.size()
+             << ",\n  \"cpu_kernels\": \"" << k_cpu_level_names[CpuDispatch::instance().level()] << "\""
+             << ",\n  \"stages\": {\n";
+        for (int s = 0; s < STAT_STAGE_COUNT; ++s) {
+            file << "    \"" << k_stat_stage_names[s] << "\": {\"produced\": " << t.produced[s]
+                 << ", \"rejected\": " << t.rejected[s] << ", \"bytes\": " << t.bytes[s] << "}"
+                 << (s + 1 < STAT_STAGE_COUNT ? "," : "") << "\n";
+        }
+        file << "  },\n  \"phases\": [\n";
+        for (size_t i = 0; i < phases_.size(); ++i) {
+            file << "    {\"name\": \"" << phases_[i].name << "\", \"wall_seconds\": " << phases_[i].wall_seconds
+                 << ", \"cpu_seconds\": " << phases_[i].cpu_seconds << "}" << (i + 1 < phases_.size() ? "," : "")
+                 << "\n";
+        }
+        file << "  ]\n}" << std::endl;
+        return static_cast<bool>(file);
+    }
+
+private:
+    Stats() : start_(std::chrono::steady_clock::now()), progress_total_(0), phase_cpu_(0) {}
+
+    ThreadStats* register_thread() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks_.emplace_back(new ThreadStats());
+        return blocks_.back().get();
+    }
+
+    /** @brief Formats a count with a K/M/G suffix, e.g. "12.3M". */
+    static std::string format_count(double value) {
+        const char* suffix = "";
+        if (value >= 1e9) { value /= 1e9; suffix = "G"; }
+        else if (value >= 1e6) { value /= 1e6; suffix = "M"; }
+        else if (value >= 1e3) { value /= 1e3; suffix = "K"; }
+        std::ostringstream text;
+        text << std::fixed;
+        text.precision(*suffix != '\0' ? 2 : 0);
+        text << value << suffix;
+        return text.str();
+    }
+
+    /** @brief Formats seconds as H:MM:SS. */
+    static std::string format_duration(double seconds) {
+        const uint64_t total = static_cast<uint64_t>(seconds + 0.5);
+        char text[32];
+        std::snprintf(text, sizeof(text), "%llu:%02u:%02u", static_cast<unsigned long long>(total / 3600),
+                      static_cast<unsigned>(total / 60 % 60), static_cast<unsigned>(total % 60));
+        return text;
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadStats> > blocks_; // One per thread that counted anything
+    std::chrono::steady_clock::time_point start_;      // Process start (for rates)
+    uint64_t progress_total_;                          // Work units of the whole run (0 = unknown)
+    std::string progress_unit_;                        // Name of a work unit
+    std::vector<Phase> phases_;                        // Finished phases
+    std::string phase_name_;                           // Current phase ("" = none)
+    std::chrono::steady_clock::time_point phase_wall_; // Start of the current phase
+    std::clock_t phase_cpu_;                           // CPU clock at the start of the current phase
+};
+
+/**
+ * @brief Prints Stats::print_progress() periodically from a background thread.
+ */
+class ProgressReporter {
+public:
+    /** @param interval_seconds Seconds between lines; 0 disables the reporter. */
+    explicit ProgressReporter(unsigned interval_seconds) : stop_(false) {
+        if (interval_seconds == 0) return;
+        thread_ = std::thread([this, interval_seconds]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!wake_.wait_for(lock, std::chrono::seconds(interval_seconds), [this]() { return stop_; })) {
+                Stats::global().print_progress();
+            }
+        });
+    }
+
+    ~ProgressReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+private:
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_;
+};
+
+// --- Candidate Storage ---
+
+/**
+ * @brief Insertion-ordered set of unique candidates.
+ * Candidate bytes are appended to one contiguous arena, each terminated by '\n',
+ * so the arena is already the final output format. Membership is tracked by a
+ * flat open-addressing table (linear probing) of 16-byte slots holding the full
+ * 64-bit hash plus the candidate's arena offset and length. Compared with a
+ * std::set<std::string> this avoids a heap node and a string allocation per
+ * candidate and replaces O(log n) string compares with one hash and usually one
+ * memcmp.
+ */
+class CandidateSet {
+public:
+    /**
+     * @param expected_size Number of candidates to size the table for up front.
+     */
+    explicit CandidateSet(size_t expected_size = 1024) : count_(0) {
+        size_t capacity = 16;
+        while (capacity * k_max_load_num < expected_size * k_max_load_den) capacity <<= 1;
+        table_.assign(capacity, Slot());
+        mask_ = capacity - 1;
+    }
+
+    /**
+     * @brief Inserts a candidate if it is not already present.
+     * Empty candidates and candidates longer than max_length() are rejected.
+     * @return true if the candidate was new and has been added, false otherwise.
+     */
+    bool insert(const char* data, size_t size) {
+        if (size == 0 || size > k_max_length) return false;
+        uint64_t h = hash_bytes(data, size);
+        size_t pos = h & mask_;
+        while (table_[pos].packed != 0) {
+            if (table_[pos].hash == h && matches(table_[pos], data, size)) return false;
+            pos = (pos + 1) & mask_;
+        }
+        if (arena_.size() > k_max_offset) {
+            throw std::length_error("CandidateSet: arena exceeds addressable size");
+        }
+        table_[pos].hash = h;
+        table_[pos].packed = (static_cast<uint64_t>(arena_.size()) << k_length_bits) | size;
+        arena_.insert(arena_.end(), data, data + size);
+        arena_.push_back('\n');
+        if (++count_ * k_max_load_den > table_.size() * k_max_load_num) grow();
+        return true;
+    }
+
+    bool insert(const std::string& candidate) { return insert(candidate.data(), candidate.size()); }
+
+    /** @return true if the candidate is present. */
+    bool contains(const char* data, size_t size) const {
+        if (size == 0 || size > k_max_length) return false;
+        uint64_t h = hash_bytes(data, size);
+        size_t pos = h & mask_;
+        while (table_[pos].packed != 0) {
+            if (table_[pos].hash == h && matches(table_[pos], data, size)) return true;
+            pos = (pos + 1) & mask_;
+        }
+        return false;
+    }
+
+    /** @return The number of unique candidates stored. */
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    /** @return Bytes allocated for the arena and the hash table. */
+    size_t memory_usage() const { return arena_.capacity() + table_.size() * sizeof(Slot); }
+
+    /** @return The arena: every candidate in insertion order, each followed by '\n'. */
+    const char* arena_data() const { return arena_.data(); }
+    size_t arena_size() const { return arena_.size(); }
+
+    /** @return The longest candidate the set can store. */
+    static size_t max_length() { return k_max_length; }
+
+    /**
+     * @brief Inserts every candidate of another set, in its insertion order.
+     * @param other The set to merge from.
+     * @return The number of candidates that were new to this set.
+     */
+    size_t merge(const CandidateSet& other) {
+        size_t added = 0;
+        other.for_each([this, &added](StringView candidate) {
+            if (insert(candidate.data(), candidate.size())) ++added;
+        });
+        return added;
+    }
+
+    /**
+     * @brief Calls f(StringView) for every candidate in insertion order.
+     * The views point into the arena and are invalidated by the next insert().
+     */
+    template <typename F>
+    void for_each(F f) const {
+        const char* p = arena_.data();
+        const char* end = p + arena_.size();
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            f(StringView(p, nl - p));
+            p = nl + 1;
+        }
+    }
+
+    /**
+     * @brief Calls f(StringView) for every candidate stored before the call, in insertion order.
+     * Unlike for_each(), f may insert into this set (e.g. to add variants of
+     * each candidate): the walk keeps arena offsets rather than pointers, each
+     * candidate is copied to a reused scratch buffer before f sees it, and the
+     * candidates f adds are not visited. Nothing is allocated per candidate.
+     */
+    template <typename F>
+    void for_each_stable(F f) const {
+        const size_t end = arena_.size();
+        std::string candidate;
+        size_t offset = 0;
+        while (offset < end) {
+            const char* p = arena_.data() + offset; // Re-read: f may have grown the arena
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - offset));
+            candidate.assign(p, nl - p);
+            offset += candidate.size() + 1;
+            f(StringView(candidate));
+        }
+    }
+
+private:
+    // Slot layout: packed = (arena offset << 24) | length; packed == 0 marks an
+    // empty slot (a stored candidate always has a non-zero length).
+    struct Slot {
+        uint64_t hash = 0;
+        uint64_t packed = 0;
+    };
+
+    static const unsigned k_length_bits = 24;
+    static const size_t k_max_length = (static_cast<size_t>(1) << k_length_bits) - 1;
+    static const uint64_t k_max_offset = (static_cast<uint64_t>(1) << (64 - k_length_bits)) - 1;
+    // Maximum load factor 7/10 keeps linear-probe chains short
+    static const size_t k_max_load_num = 7;
+    static const size_t k_max_load_den = 10;
+
+    bool matches(const Slot& slot, const char* data, size_t size) const {
+        return (slot.packed & k_max_length) == size &&
+               std::memcmp(arena_.data() + (slot.packed >> k_length_bits), data, size) == 0;
+    }
+
+    /** @brief Doubles the table and re-inserts every slot using its stored hash. */
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(table_);
+        table_.assign(old.size() * 2, Slot());
+        mask_ = table_.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.packed == 0) continue;
+            size_t pos = slot.hash & mask_;
+            while (table_[pos].packed != 0) pos = (pos + 1) & mask_;
+            table_[pos] = slot;
+        }
+    }
+
+    std::vector<Slot> table_; // Open-addressing hash table
+    std::vector<char> arena_; // Candidate bytes, '\n'-terminated, insertion order
+    size_t count_;            // Number of stored candidates
+    size_t mask_;             // table_.size() - 1 (size is a power of two)
+};
+
+/**
+ * @brief Fixed-size approximate set: a cache-line-blocked Bloom filter.
+ * Each candidate hashes to one 64-byte block and sets k bits inside it, so a
+ * lookup costs one cache miss instead of k. Memory is fixed at construction,
+ * whatever the number of candidates; the price is a false-positive rate that
+ * grows with the load (a false positive drops a new candidate as a repeat).
+ * Bits are set with atomic OR, so one filter can be shared by worker threads.
+ */
+class BloomFilter {
+public:
+    static const size_t k_block_bytes = 64;
+    static const unsigned k_block_bits = 512;
+
+    /**
+     * @param memory_bytes Memory budget (rounded down to whole blocks, at least one).
+     * @param expected_items Expected number of distinct insertions, used to pick
+     *        the number of bits per item that minimises the false-positive rate.
+     */
+    BloomFilter(size_t memory_bytes, uint64_t expected_items)
+        : words_(nullptr), blocks_(std::max<size_t>(1, memory_bytes / k_block_bytes)), expected_(expected_items) {
+        const double bits_per_item = static_cast<double>(blocks_) * k_block_bits /
+                                     static_cast<double>(std::max<uint64_t>(1, expected_items));
+        hashes_ = static_cast<unsigned>(std::max(1.0, std::min(16.0, std::floor(bits_per_item * std::log(2.0) + 0.5))));
+        void* memory = nullptr;
+        if (posix_memalign(&memory, k_block_bytes, blocks_ * k_block_bytes) != 0) {
+            throw std::bad_alloc();
+        }
+        words_ = static_cast<uint64_t*>(memory);
+        std::memset(words_, 0, blocks_ * k_block_bytes);
+    }
+
+    ~BloomFilter() { free(words_); }
+
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    /**
+     * @brief Adds a candidate.
+     * @return true if the candidate was (probably) not in the filter yet.
+     */
+    bool insert(const char* data, size_t size) {
+        const uint64_t h = hash_bytes(data, size);
+        uint64_t* block = words_ + static_cast<size_t>(mul_high64(h, blocks_)) * 8;
+        // Bit positions are independent 9-bit fields drawn from a SplitMix64
+        // stream seeded with h (7 per 64-bit draw). Double hashing (h1 + i * h2)
+        // would only give 2^18 distinct patterns per block and collide often.
+        uint64_t state = h;
+        uint64_t fields = 0;
+        bool added = false;
+        for (unsigned i = 0; i < hashes_; ++i) {
+            if (i % 7 == 0) {
+                state += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = state;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                fields = z ^ (z >> 31);
+            }
+            const unsigned bit = static_cast<unsigned>(fields & (k_block_bits - 1));
+            fields >>= 9;
+            uint64_t& word = block[bit >> 6];
+            const uint64_t mask = 1ULL << (bit & 63);
+            if ((__atomic_load_n(&word, __ATOMIC_RELAXED) & mask) != 0) continue;
+            added |= (__atomic_fetch_or(&word, mask, __ATOMIC_RELAXED) & mask) == 0;
+        }
+        return added;
+    }
+
+    /** @return The number of bits set per candidate. */
+    unsigned hash_count() const { return hashes_; }
+    /** @return The filter size in bytes. */
+    size_t memory() const { return blocks_ * k_block_bytes; }
+
+    /**
+     * @brief Estimates the false-positive rate once expected_items are inserted.
+     * Block loads are Poisson distributed around the mean, and the rate is
+     * averaged over them; this is slightly worse than an unblocked filter.
+     */
+    double false_positive_rate() const {
+        const double mean = static_cast<double>(expected_) / static_cast<double>(blocks_);
+        const double limit = mean + 12.0 * std::sqrt(mean) + 32.0;
+        double rate = 0.0;
+        double log_p = -mean; // log Poisson(mean, 0)
+        for (double load = 0.0; load <= limit; load += 1.0) {
+            if (load > 0.0) log_p += std::log(mean) - std::log(load);
+            const double unset = std::pow(1.0 - 1.0 / k_block_bits, hashes_ * load);
+            rate += std::exp(log_p) * std::pow(1.0 - unset, static_cast<double>(hashes_));
+        }
+        return std::min(1.0, rate);
+    }
+
+private:
+    uint64_t* words_;   // blocks_ * 8 words, 64-byte aligned
+    size_t blocks_;     // Number of 512-bit blocks
+    uint64_t expected_; // Expected distinct insertions
+    unsigned hashes_;   // Bits set per candidate (k)
+};
+
+/**
+ * @brief Static membership filter over 64-bit keys (xor filter, 16-bit fingerprints).
+ * Every key maps to three slots, one in each third of the table, and the
+ * table is filled so that the xor of the three slots equals the key's
+ * fingerprint. A lookup is one hash and three 2-byte loads; the table takes
+ * about 1.23 * 16 = 19.7 bits per key and reports a key that was not added
+ * with probability 2^-16. The set is fixed once built (Graf & Lemire, "Xor
+ * Filters: Faster and Smaller Than Bloom and Cuckoo Filters", 2020).
+ */
+class XorFilter {
+public:
+    XorFilter() : seed_(0), block_length_(0) {}
+
+    /**
+     * @brief Builds the filter, replacing any previous contents.
+     * @param keys The keys to store; sorted and de-duplicated in place.
+     */
+    void build(std::vector<uint64_t>& keys) {
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        const size_t capacity = 32 + static_cast<size_t>(1.23 * static_cast<double>(keys.size()));
+        block_length_ = capacity / 3 + 1;
+        fingerprints_.assign(3 * block_length_, 0);
+
+        std::vector<uint32_t> counts(fingerprints_.size());
+        std::vector<uint64_t> masks(fingerprints_.size()); // Xor of the hashes mapped to each slot
+        std::vector<std::pair<uint64_t, uint32_t> > peeled; // (hash, slot) in peeling order
+        std::vector<uint32_t> queue;
+        peeled.reserve(keys.size());
+        // Peeling fails with small probability; retry with another seed
+        for (uint64_t attempt = 1;; ++attempt) {
+            seed_ = mix(0x5EED5EED5EED5EEDULL * attempt);
+            std::fill(counts.begin(), counts.end(), 0);
+            std::fill(masks.begin(), masks.end(), 0);
+            for (uint64_t key : keys) {
+                const uint64_t h = mix(key + seed_);
+                for (int i = 0; i < 3; ++i) {
+                    const size_t slot = position(h, i);
+                    ++counts[slot];
+                    masks[slot] ^= h;
+                }
+            }
+            queue.clear();
+            for (size_t slot = 0; slot < counts.size(); ++slot) {
+                if (counts[slot] == 1) queue.push_back(static_cast<uint32_t>(slot));
+            }
+            peeled.clear();
+            while (!queue.empty()) {
+                const uint32_t slot = queue.back();
+                queue.pop_back();
+                if (counts[slot] != 1) continue;
+                const uint64_t h = masks[slot];
+                peeled.push_back(std::make_pair(h, slot));
+                for (int i = 0; i < 3; ++i) {
+                    const size_t other = position(h, i);
+                    masks[other] ^= h;
+                    if (--counts[other] == 1) queue.push_back(static_cast<uint32_t>(other));
+                }
+            }
+            if (peeled.size() == keys.size()) break;
+        }
+        // Assign in reverse peeling order: each slot is the last free one of its key
+        for (size_t n = peeled.size(); n-- > 0;) {
+            const uint64_t h = peeled[n].first;
+            uint16_t value = fingerprint(h);
+            for (int i = 0; i < 3; ++i) value ^= fingerprints_[position(h, i)];
+            fingerprints_[peeled[n].second] ^= value; // The slot itself is still 0
+        }
+    }
+
+    /** @return true if key was added (or, with probability 2^-16, if it was not). */
+    bool contains(uint64_t key) const {
+        if (fingerprints_.empty()) return false;
+        const uint64_t h = mix(key + seed_);
+        return fingerprint(h) == (fingerprints_[position(h, 0)] ^ fingerprints_[position(h, 1)] ^
+                                  fingerprints_[position(h, 2)]);
+    }
+
+    /** @return The filter size in bytes. */
+    size_t memory() const { return fingerprints_.size() * sizeof(uint16_t); }
+
+private:
+    /** @brief MurmurHash3 fmix64: spreads the seeded key over all 64 bits. */
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static uint16_t fingerprint(uint64_t h) { return static_cast<uint16_t>(h ^ (h >> 32)); }
+
+    /** @brief Slot of h in third i: a 21-bit rotation per third, range-reduced by multiply-shift. */
+    size_t position(uint64_t h, int i) const {
+        const uint64_t r = (h << (21 * i)) | (i == 0 ? 0 : h >> (64 - 21 * i));
+        return static_cast<size_t>(((r & 0xFFFFFFFFULL) * block_length_) >> 32) + i * block_length_;
+    }
+
+    uint64_t seed_;                      // Seed of the successful construction
+    size_t block_length_;                // Slots per third of the table
+    std::vector<uint16_t> fingerprints_; // 3 * block_length_ fingerprints
+};
+
+// --- Output Stage ---
+
+// Set by SIGINT/SIGTERM while a checkpointed run is active; OutputWriter stops writing once it is set
+volatile std::sig_atomic_t g_stop_requested = 0;
+
+// C linkage for sigaction(); static so the name stays out of the library's symbols
+extern "C" {
+static void request_stop(int) { g_stop_requested = 1; }
+}
+
+/**
+ * @brief Routes a signal to request_stop() without SA_RESTART.
+ * std::signal() restarts interrupted system calls on glibc, so a write(2)
+ * blocked on a stalled pipe would never see the signal; here it returns
+ * EINTR and the writer can give up.
+ */
+void install_stop_handler(int signal_number) {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(signal_number, &action, nullptr);
+}
+
+/**
+ * @brief Batched writer for candidate output.
+ * Candidates are appended to a large page-aligned buffer which is handed to
+ * write(2) only when full, instead of flushing a std::ostream on every line.
+ * This keeps the pipe into the cracker full with a handful of system calls.
+ */
+class OutputWriter {
+public:
+    static const size_t k_default_buffer_size = 1 << 20; // 1 MiB
+    static const size_t k_buffer_alignment = 4096;
+
+    /**
+     * @param buffer_size Size of the output buffer in bytes.
+     * @param fd The file descriptor to write to (stdout by default).
+     */
+    explicit OutputWriter(size_t buffer_size = k_default_buffer_size, int fd = STDOUT_FILENO)
+        : buffer_(nullptr), capacity_(buffer_size < 4096 ? 4096 : buffer_size),
+          used_(0), fd_(fd), failed_(false), bytes_written_(0) {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, k_buffer_alignment, capacity_) != 0) {
+            throw std::bad_alloc();
+        }
+        buffer_ = static_cast<char*>(memory);
+    }
+
+    ~OutputWriter() {
+        flush();
+        free(buffer_);
+    }
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    /**
+     * @brief Appends one candidate followed by a newline.
+     * @param data Candidate bytes.
+     * @param size Candidate length.
+     */
+    void write_line(const char* data, size_t size) {
+        if (size + 1 > capacity_ - used_) {
+            flush();
+            if (size + 1 > capacity_) { // Oversized line: bypass the buffer
+                write_all(data, size);
+                write_all("\n", 1);
+                return;
+            }
+        }
+        std::memcpy(buffer_ + used_, data, size);
+        buffer_[used_ + size] = '\n';
+        used_ += size + 1;
+    }
+
+    void write_line(StringView candidate) { write_line(candidate.data(), candidate.size()); }
+
+    /**
+     * @brief Appends pre-formatted bytes (already newline-terminated).
+     * Blocks larger than the buffer are written directly without copying.
+     */
+    void write_block(const char* data, size_t size) {
+        if (size > capacity_ - used_) {
+            flush();
+            if (size >= capacity_) {
+                write_all(data, size);
+                return;
+            }
+        }
+        std::memcpy(buffer_ + used_, data, size);
+        used_ += size;
+    }
+
+    /** @brief Writes out everything buffered so far. */
+    void flush() {
+        if (used_ == 0) return;
+        write_all(buffer_, used_);
+        used_ = 0;
+    }
+
+    /** @return false once a write has failed (e.g. the reading end of the pipe closed). */
+    bool ok() const { return !failed_; }
+
+    /** @return Total bytes successfully handed to the kernel. */
+    size_t bytes_written() const { return bytes_written_; }
+
+    /**
+     * @brief Decouples the C++ standard streams from C stdio and from each other.
+     * Turns off stdio synchronisation and unties cin from cout, so any remaining
+     * iostream use does not force a flush of cout before every read.
+     */
+    static void untie_standard_streams() {
+        std::ios::sync_with_stdio(false);
+        std::cin.tie(nullptr);
+    }
+
+private:
+    /**
+     * @brief Loops over write(2) until everything is written, retrying on EINTR.
+     * Once a stop is requested (g_stop_requested) the writer fails instead of
+     * retrying, so SIGINT ends a write blocked on a consumer that stopped reading.
+     */
+    void write_all(const char* data, size_t size) {
+        while (size > 0 && !failed_) {
+            if (g_stop_requested) {
+                failed_ = true; // Checkpointing counts what was delivered via bytes_written()
+                return;
+            }
+            ssize_t n = ::write(fd_, data, size);
+            if (n < 0) {
+                if (errno == EINTR) continue; // Re-checks the stop request first
+                failed_ = true; // EPIPE etc.: the consumer has gone away
+                return;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+            bytes_written_ += static_cast<size_t>(n);
+        }
+    }
+
+    char* buffer_;         // Page-aligned output buffer
+    size_t capacity_;      // Buffer size in bytes
+    size_t used_;          // Bytes currently buffered
+    int fd_;               // Destination file descriptor
+    bool failed_;          // Set after a write error
+    size_t bytes_written_; // Bytes successfully written
+};
+
+// --- Input Loading ---
+
+/**
+ * @brief Read-only view of a whole file's contents.
+ * Regular files are memory-mapped; anything that cannot be mapped (pipes,
+ * process substitution, ...) is read into an owned buffer instead.
+ */
+class MappedFile {
+public:
+    MappedFile() : data_(nullptr), size_(0), mapped_(false) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Maps (or reads) the file at path.
+     * @return false if the file cannot be opened or read.
+     */
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        bool ok = false;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0) {
+                ok = true; // Nothing to map
+            } else {
+                void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    // Advice values are codes, not flags: one call per hint.
+                    // Both are only hints, so a failure costs read-ahead, not correctness.
+                    if (madvise(p, size_, MADV_SEQUENTIAL) != 0 || madvise(p, size_, MADV_WILLNEED) != 0) {
+                        std::cerr << "Warning: madvise() failed for " << path << ": " << std::strerror(errno)
+                                  << "; reading without read-ahead hints." << std::endl;
+                    }
+                    data_ = static_cast<const char*>(p);
+                    mapped_ = true;
+                    ok = true;
+                }
+            }
+        }
+        if (!ok) ok = read_all(fd);
+        ::close(fd);
+        return ok;
+    }
+
+    /** @brief Releases the mapping or buffer. Views into the file become invalid. */
+    void close() {
+        if (mapped_) munmap(const_cast<char*>(data_), size_);
+        buffer_.clear();
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    /** @brief Fallback for unmappable files: read everything into buffer_. */
+    bool read_all(int fd) {
+        buffer_.clear();
+        char chunk[65536];
+        for (;;) {
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (n == 0) break;
+            buffer_.insert(buffer_.end(), chunk, chunk + n);
+        }
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        return true;
+    }
+
+    const char* data_;         // File contents (mapping or buffer_)
+    size_t size_;              // Size of the contents in bytes
+    bool mapped_;              // true if data_ is an mmap() region
+    std::vector<char> buffer_; // Owned copy for unmappable files
+};
+
+/**
+ * @brief Calls on_line(begin, end) for every '\n'-separated line in a buffer.
+ * The newline offsets of each 64 KiB block are collected by the dispatched
+ * find_newlines kernel (a vector compare yields a bitmask whose set bits are
+ * walked with count-trailing-zeros), so short lines do not pay for restarting
+ * a scan. A final line without a trailing newline is reported as well.
+ */
+template <typename F>
+void scan_lines(const char* data, size_t size, F on_line) {
+    const size_t k_block_size = 1 << 16;
+    std::vector<uint32_t> newlines(std::min(size, k_block_size));
+    const CpuKernels& kernels = cpu_kernels();
+    const char* line_start = data;
+    for (size_t offset = 0; offset < size; offset += k_block_size) {
+        const char* block = data + offset;
+        const size_t count = kernels.find_newlines(block, std::min(k_block_size, size - offset), newlines.data());
+        for (size_t i = 0; i < count; ++i) {
+            const char* nl = block + newlines[i];
+            on_line(line_start, nl);
+            line_start = nl + 1;
+        }
+    }
+    if (line_start < data + size) on_line(line_start, data + size);
+}
+
+/**
+ * @brief A loaded wordlist: the mapped file plus one view per non-empty line.
+ * Lines are StringViews straight into the mapping (trailing '\r' from Windows
+ * files stripped), so loading allocates nothing per line. The views stay valid
+ * for the lifetime of the Wordlist.
+ */
+class Wordlist {
+public:
+    Wordlist() {}
+
+    Wordlist(const Wordlist&) = delete;
+    Wordlist& operator=(const Wordlist&) = delete;
+
+    /**
+     * @brief Loads the file at path, replacing any previous contents.
+     * @param path The path to the file to load.
+     * @return false if the file cannot be opened (a warning is printed); the list is then empty.
+     */
+    bool load(const std::string& path) {
+        lines_.clear();
+        if (!file_.open(path)) {
+            // Print warning to standard error
+            std::cerr << "Warning: Could not open file: " << path << ". Skipping." << std::endl;
+            return false;
+        }
+        scan_lines(file_.data(), file_.size(), [this](const char* begin, const char* end) {
+            // Remove potential trailing carriage return ('\r') from Windows files
+            if (end > begin && end[-1] == '\r') --end;
+            // Keep non-empty lines only
+            if (end > begin) lines_.push_back(StringView(begin, end - begin));
+        });
+        return true;
+    }
+
+    const std::vector<StringView>& lines() const { return lines_; }
+    size_t size() const { return lines_.size(); }
+    bool empty() const { return lines_.empty(); }
+    std::vector<StringView>::const_iterator begin() const { return lines_.begin(); }
+    std::vector<StringView>::const_iterator end() const { return lines_.end(); }
+
+private:
+    MappedFile file_;               // Backing storage for the views
+    std::vector<StringView> lines_; // One view per non-empty line
+};
+
+/**
+ * @brief Decodes a string of hex digit pairs.
+ * @param begin First digit.
+ * @param end One past the last digit.
+ * @param out Receives the decoded bytes.
+ * @return false if the length is odd or a character is not a hex digit.
+ */
+bool decode_hex(const char* begin, const char* end, std::string& out) {
+    if ((end - begin) % 2 != 0) return false;
+    out.clear();
+    for (const char* p = begin; p < end; p += 2) {
+        int digits[2];
+        for (int i = 0; i < 2; ++i) {
+            const char c = p[i];
+            if (c >= '0' && c <= '9') digits[i] = c - '0';
+            else if (c >= 'a' && c <= 'f') digits[i] = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digits[i] = c - 'A' + 10;
+            else return false;
+        }
+        out.push_back(static_cast<char>((digits[0] << 4) | digits[1]));
+    }
+    return true;
+}
+
+/**
+ * @brief Adds the hashes of the entries of a wordlist or potfile to an exclusion key list.
+ * Files named *.pot or *.potfile are read as hashcat/John potfiles ("hash:plain"),
+ * taking the plaintext after the last ':' and decoding hashcat's $HEX[...] form.
+ * A $HEX[...] entry with an odd number of digits or a non-hex digit is taken
+ * literally, as hashcat does, and a warning with the number of such entries is printed.
+ * @param path The file to read.
+ * @param keys Receives hash_bytes() of every entry.
+ * @return false if the file cannot be opened (a warning is printed).
+ */
+bool load_exclusions(const std::string& path, std::vector<uint64_t>& keys) {
+    Wordlist list;
+    if (!list.load(path)) return false;
+    const bool potfile = (path.size() >= 4 && path.compare(path.size() - 4, 4, ".pot") == 0) ||
+                         (path.size() >= 8 && path.compare(path.size() - 8, 8, ".potfile") == 0);
+    keys.reserve(keys.size() + list.size());
+    std::string decoded;
+    size_t malformed = 0;
+    for (StringView line : list) {
+        const char* begin = line.data();
+        const char* end = begin + line.size();
+        if (potfile) {
+            const char* colon = end;
+            while (colon > begin && colon[-1] != ':') --colon;
+            if (colon == begin) continue; // Not a "hash:plain" line
+            begin = colon;
+            if (end - begin >= 6 && std::memcmp(begin, "$HEX[", 5) == 0 && end[-1] == ']') {
+                if (decode_hex(begin + 5, end - 1, decoded)) {
+                    keys.push_back(hash_bytes(decoded.data(), decoded.size()));
+                    continue;
+                }
+                ++malformed; // Falls through: the plaintext is taken as written
+            }
+        }
+        if (end > begin) keys.push_back(hash_bytes(begin, end - begin));
+    }
+    if (malformed != 0) {
+        std::cerr << "Warning: " << malformed << " malformed $HEX[...] entries in " << path
+                  << " (odd length or non-hex digits) were taken literally." << std::endl;
+    }
+    return true;
+}
+
+// --- Candidate Sinks ---
+
+/**
+ * @brief Destination for generated candidates.
+ * Generation strategies hand every candidate they produce to a sink instead of
+ * inserting into a container directly. The same strategy code can then either
+ * collect candidates for global de-duplication or stream them straight out.
+ */
+class CandidateSink {
+public:
+    virtual ~CandidateSink() {}
+
+    /**
+     * @brief Accepts one generated candidate.
+     * @param candidate The candidate; only valid for the duration of the call.
+     */
+    virtual void emit(StringView candidate) = 0;
+};
+
+/**
+ * @brief Sink that collects candidates into a CandidateSet (exact de-duplication).
+ * Memory grows with the number of unique candidates; nothing is output until
+ * generation has finished.
+ */
+class SetSink : public CandidateSink {
+public:
+    /**
+     * @param count_kept Count new candidates as kept; a shard that is merged
+     *        later leaves that to the merge, which sees the repeats across shards.
+     */
+    explicit SetSink(CandidateSet& candidates, bool count_kept = true)
+        : candidates_(candidates), count_kept_(count_kept), stats_(Stats::local().stages[STAT_DEDUP]) {}
+
+    void emit(StringView candidate) override {
+        if (candidates_.insert(candidate.data(), candidate.size())) {
+            if (count_kept_) ThreadStats::add(stats_.produced, 1);
+        } else {
+            ThreadStats::add(stats_.rejected, 1);
+        }
+    }
+
+private:
+    CandidateSet& candidates_;
+    bool count_kept_;
+    ThreadStats::Counters& stats_; // Dedup counters of the owning thread
+};
+
+/**
+ * @brief Bounded filter that remembers the hashes of recently seen candidates.
+ * A direct-mapped cache: each candidate's hash selects one slot, and a repeat
+ * is reported only if that slot still holds the same hash. This catches the
+ * repeats that the combinators produce close together at a fixed memory cost;
+ * duplicates that are far apart can still get through.
+ */
+class RecentFilter {
+public:
+    /**
+     * @param cache_bits log2 of the number of slots in the cache.
+     */
+    explicit RecentFilter(unsigned cache_bits = 16)
+        : recent_(static_cast<size_t>(1) << cache_bits, 0),
+          mask_((static_cast<size_t>(1) << cache_bits) - 1) {}
+
+    /**
+     * @brief Records a candidate.
+     * @return true if the candidate was not seen recently (and should be kept).
+     */
+    bool insert(const char* data, size_t size) {
+        uint64_t h = hash_bytes(data, size);
+        uint64_t& slot = recent_[h & mask_];
+        if (slot == h) return false; // Seen recently, skip the repeat
+        slot = h;
+        return true;
+    }
+
+    /** @brief Forgets everything seen so far. */
+    void clear() { std::fill(recent_.begin(), recent_.end(), 0); }
+
+private:
+    std::vector<uint64_t> recent_; // Hash of the last candidate seen in each slot (0 = empty)
+    size_t mask_;                  // recent_.size() - 1
+};
+
+/**
+ * @brief Sink that writes candidates to an OutputWriter as soon as they are produced.
+ * Memory stays bounded: instead of remembering every candidate, a RecentFilter
+ * suppresses nearby repeats. Duplicates that are far apart in the stream can
+ * still reach the output (crackers tolerate these).
+ */
+class StreamSink : public CandidateSink {
+public:
+    /**
+     * @param writer The output stage that receives the candidates.
+     * @param recent_cache_bits log2 of the number of slots in the recent-candidate
+     *        cache; 0 disables filtering (the input is already de-duplicated).
+     */
+    explicit StreamSink(OutputWriter& writer, unsigned recent_cache_bits = 16)
+        : writer_(writer), recent_(recent_cache_bits), filter_(recent_cache_bits != 0), emitted_(0),
+          stats_(Stats::local()) {}
+
+    void emit(StringView candidate) override {
+        if (filter_) {
+            if (!recent_.insert(candidate.data(), candidate.size())) {
+                ThreadStats::add(stats_.stages[STAT_DEDUP].rejected, 1);
+                return;
+            }
+            ThreadStats::add(stats_.stages[STAT_DEDUP].produced, 1);
+        }
+        writer_.write_line(candidate.data(), candidate.size());
+        ++emitted_;
+        stats_.add_output(1, candidate.size() + 1);
+    }
+
+    /** @return The number of candidates written so far. */
+    size_t emitted() const { return emitted_; }
+
+private:
+    OutputWriter& writer_; // Destination for emitted candidates
+    RecentFilter recent_;  // Nearby-duplicate filter
+    bool filter_;          // false if recent_ is disabled
+    size_t emitted_;       // Candidates written to stdout
+    ThreadStats& stats_;   // Counters of the owning thread
+};
+
+/**
+ * @brief Sink that collects newline-terminated candidates in a local byte buffer.
+ * Used by streaming worker threads: each worker fills its own buffer (with its
+ * own RecentFilter) and hands the whole block to the shared OutputWriter. With
+ * a drain hook set, a buffer that reaches the piece size is handed on early,
+ * so a large chunk never sits in memory whole.
+ */
+class BufferSink : public CandidateSink {
+public:
+    /**
+     * @param recent_cache_bits Size of the nearby-duplicate filter; 0 disables filtering.
+     */
+    explicit BufferSink(unsigned recent_cache_bits = 16)
+        : recent_(recent_cache_bits), filter_(recent_cache_bits != 0), emitted_(0), piece_bytes_(0),
+          stats_(Stats::local().stages[STAT_DEDUP]) {}
+
+    /**
+     * @brief Calls drain() whenever the buffer reaches piece_bytes; drain is
+     * expected to write the buffer out and empty it with clear_buffer().
+     */
+    void set_drain(size_t piece_bytes, std::function<void()> drain) {
+        piece_bytes_ = piece_bytes;
+        drain_ = std::move(drain);
+    }
+
+    void emit(StringView candidate) override {
+        if (filter_) {
+            if (!recent_.insert(candidate.data(), candidate.size())) {
+                ThreadStats::add(stats_.rejected, 1);
+                return;
+            }
+            ThreadStats::add(stats_.produced, 1);
+        }
+        buffer_.insert(buffer_.end(), candidate.data(), candidate.data() + candidate.size());
+        buffer_.push_back('\n');
+        ++emitted_;
+        if (piece_bytes_ != 0 && buffer_.size() >= piece_bytes_) drain_();
+    }
+
+    /** @return The buffered bytes (newline-terminated candidates). */
+    const std::vector<char>& buffer() const { return buffer_; }
+
+    /** @brief Empties the buffer and the duplicate filter (capacity is kept). */
+    void reset() {
+        buffer_.clear();
+        if (filter_) recent_.clear();
+    }
+
+    /** @brief Empties the buffer only, keeping the duplicate filter (after a drained piece). */
+    void clear_buffer() { buffer_.clear(); }
+
+    /** @return The number of candidates buffered since construction. */
+    size_t emitted() const { return emitted_; }
+
+private:
+    std::vector<char> buffer_; // Newline-terminated candidates
+    RecentFilter recent_;      // Nearby-duplicate filter
+    bool filter_;              // Apply recent_ to incoming candidates
+    size_t emitted_;           // Candidates accepted
+    size_t piece_bytes_;       // Buffer size that triggers drain_ (0 = never)
+    std::function<void()> drain_; // Writes out a full buffer
+    ThreadStats::Counters& stats_; // Dedup counters of the owning thread
+};
+
+/**
+ * @brief Sink decorator that drops candidates found in an exclusion filter.
+ * Used as the last transform stage, so candidates already tried or cracked
+ * (prior wordlists, potfiles) never reach the output.
+ */
+class ExcludeSink : public CandidateSink {
+public:
+    ExcludeSink(const XorFilter& exclude, CandidateSink& next)
+        : exclude_(exclude), next_(next), stats_(Stats::local().stages[STAT_EXCLUDE]) {}
+
+    void emit(StringView candidate) override {
+        if (!exclude_.contains(hash_bytes(candidate.data(), candidate.size()))) next_.emit(candidate);
+        else ThreadStats::add(stats_.rejected, 1);
+    }
+
+private:
+    const XorFilter& exclude_;
+    CandidateSink& next_;
+    ThreadStats::Counters& stats_; // Exclusion counters of the owning thread
+};
+
+/**
+ * @brief Sink decorator that drops candidates already recorded in a BloomFilter.
+ * Gives whole-run de-duplication in bounded memory; a false positive drops a
+ * new candidate. Safe to use from several threads on one shared filter.
+ */
+class ApproxDedupSink : public CandidateSink {
+public:
+    ApproxDedupSink(BloomFilter& filter, CandidateSink& next)
+        : filter_(filter), next_(next), stats_(Stats::local().stages[STAT_DEDUP]) {}
+
+    void emit(StringView candidate) override {
+        if (filter_.insert(candidate.data(), candidate.size())) {
+            ThreadStats::add(stats_.produced, 1);
+            next_.emit(candidate);
+        } else {
+            ThreadStats::add(stats_.rejected, 1);
+        }
+    }
+
+private:
+    BloomFilter& filter_;
+    CandidateSink& next_;
+    ThreadStats::Counters& stats_; // Dedup counters of the owning thread
+};
+
+/**
+ * @brief Sink decorator that drops candidates already recorded in a CandidateSet.
+ * Exact whole-run de-duplication that still forwards each new candidate at
+ * once (first-occurrence order), instead of only after generation has finished.
+ */
+class ExactDedupSink : public CandidateSink {
+public:
+    ExactDedupSink(CandidateSet& seen, CandidateSink& next)
+        : seen_(seen), next_(next), stats_(Stats::local().stages[STAT_DEDUP]) {}
+
+    void emit(StringView candidate) override {
+        if (seen_.insert(candidate.data(), candidate.size())) {
+            ThreadStats::add(stats_.produced, 1);
+            next_.emit(candidate);
+        } else {
+            ThreadStats::add(stats_.rejected, 1);
+        }
+    }
+
+private:
+    CandidateSet& seen_;
+    CandidateSink& next_;
+    ThreadStats::Counters& stats_; // Dedup counters of the owning thread
+};
+
+/**
+ * @brief Sink decorator that drops nearby repeats (see RecentFilter).
+ * The filtering half of StreamSink, for outputs other than the writer.
+ */
+class RecentDedupSink : public CandidateSink {
+public:
+    explicit RecentDedupSink(CandidateSink& next, unsigned recent_cache_bits = 16)
+        : recent_(recent_cache_bits), next_(next), stats_(Stats::local().stages[STAT_DEDUP]) {}
+
+    void emit(StringView candidate) override {
+        if (recent_.insert(candidate.data(), candidate.size())) {
+            ThreadStats::add(stats_.produced, 1);
+            next_.emit(candidate);
+        } else {
+            ThreadStats::add(stats_.rejected, 1);
+        }
+    }
+
+private:
+    RecentFilter recent_;
+    CandidateSink& next_;
+    ThreadStats::Counters& stats_; // Dedup counters of the owning thread
+};
+
+class LeetTable;
+
+/**
+ * @brief Sink decorator that forwards each candidate plus up to max_variants
+ * of its leetspeak variants.
+ * Used in streaming mode so leetspeak is applied as candidates are produced
+ * instead of in a separate pass over the complete candidate set.
+ */
+class LeetspeakSink : public CandidateSink {
+public:
+    /**
+     * @param table The substitution table.
+     * @param max_variants Leetspeak variants per candidate: 1 emits only the
+     *        fully substituted form, larger values also enumerate partial forms
+     *        (see LeetTable::for_each_variant()).
+     * @param next The sink that receives the candidates and their variants.
+     */
+    LeetspeakSink(const LeetTable& table, size_t max_variants, CandidateSink& next)
+        : table_(table), max_variants_(max_variants), next_(next), stats_(Stats::local().stages[STAT_LEET]) {}
+
+    void emit(StringView candidate) override;
+
+    /** @brief Emits only the variants of candidate (for input that is already kept elsewhere). */
+    void emit_variants(StringView candidate);
+
+private:
+    const LeetTable& table_;
+    size_t max_variants_;
+    CandidateSink& next_;
+    CandidateBuffer leet_word_; // Translation buffer
+    ThreadStats::Counters& stats_; // Leetspeak counters of the owning thread
+};
+
+// --- Generation Strategies ---
+
+/**
+ * @brief Case transformations applied to base words and target info.
+ */
+enum CaseForm {
+    CASE_LOWER,       // all lowercase
+    CASE_CAPITALIZED, // first character uppercased, rest unchanged
+    CASE_UPPER,       // ALL UPPERCASE
+    CASE_TOGGLED      // every letter's case swapped
+};
+
+/**
+ * @brief Applies a case transformation to a word in place.
+ */
+void apply_case_form(CaseForm form, std::string& word) {
+    switch (form) {
+    case CASE_LOWER:
+        for (char& c : word) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        break;
+    case CASE_CAPITALIZED:
+        if (!word.empty()) word[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(word[0])));
+        break;
+    case CASE_UPPER:
+        for (char& c : word) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        break;
+    case CASE_TOGGLED:
+        for (char& c : word) {
+            unsigned char u = static_cast<unsigned char>(c);
+            c = static_cast<char>(std::islower(u) ? std::toupper(u) : std::tolower(u));
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Settings for generate_target_combinations().
+ */
+struct CombinatorConfig {
+    // Example suffixes - easily expandable
+    std::vector<std::string> suffixes = {"2023", "2024", "2025", "!", "1", "123", "#"};
+    // Case forms combined with the original spelling (the default reproduces
+    // the classic "Capitalized" variations)
+    std::vector<CaseForm> case_forms = {CASE_CAPITALIZED};
+};
+
+/**
+ * @brief A word together with its enabled case forms, computed once.
+ * assign() reuses the existing string capacity, so refilling one object for
+ * every base word does not allocate in the steady state.
+ */
+struct WordVariants {
+    std::string original;            // The word as read from the list
+    std::vector<std::string> forms;  // forms[k] = original under case_forms[k]
+    std::vector<char> same;          // same[k]: forms[k] == original
+    std::vector<size_t> first_equal; // Index of the first form equal to forms[k] (k if none earlier)
+
+    void assign(StringView word, const std::vector<CaseForm>& case_forms) {
+        original.assign(word.data(), word.size());
+        forms.resize(case_forms.size());
+        same.resize(case_forms.size());
+        first_equal.resize(case_forms.size());
+        for (size_t k = 0; k < case_forms.size(); ++k) {
+            forms[k].assign(original);
+            apply_case_form(case_forms[k], forms[k]);
+            same[k] = (forms[k] == original);
+            first_equal[k] = k;
+            for (size_t j = 0; j < k; ++j) {
+                if (forms[j] == forms[k]) {
+                    first_equal[k] = j;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief Generates password candidates by combining base words with target-specific info.
+ * Includes simple concatenations, suffix additions (years, common symbols),
+ * and case variations. Case variants of every target info entry are computed
+ * once up front and those of each base word once per word; candidates are
+ * composed in one reused buffer. Combinations that are provably identical to
+ * one already emitted for the same base/info pair (e.g. a case form that does
+ * not change the word) are skipped instead of re-inserted.
+ * @param base_begin First base word (from a general wordlist) to process.
+ * @param base_end One past the last base word to process.
+ * @param target_info The target-specific strings (company names, locations, etc.).
+ * @param config Suffixes and case forms to combine.
+ * @param candidates The sink that receives every generated candidate.
+ */
+void generate_target_combinations(const StringView* base_begin,
+                                  const StringView* base_end,
+                                  const std::vector<StringView>& target_info,
+                                  const CombinatorConfig& config,
+                                  CandidateSink& candidates) {
+    const std::vector<std::string>& suffixes = config.suffixes;
+    const size_t form_count = config.case_forms.size();
+
+    // Case variants of the (small) target info list, computed once, skipping
+    // empty or non-printable entries
+    std::vector<WordVariants> infos;
+    for (StringView info : target_info) {
+        if (!is_printable(info) || info.empty()) continue;
+        infos.push_back(WordVariants());
+        infos.back().assign(info, config.case_forms);
+    }
+
+    WordVariants base;         // Case variants of the current base word (reused)
+    CandidateBuffer candidate; // Composition buffer; over-long candidates are skipped
+    uint64_t produced = 0;     // Candidates of the current base word (published per word)
+    ThreadStats& stats = Stats::local();
+    auto emit2 = [&](StringView a, StringView b) {
+        if (!candidate.assign(a, b)) return;
+        candidates.emit(candidate.view());
+        ++produced;
+    };
+    auto emit3 = [&](StringView a, StringView b, StringView c) {
+        if (!candidate.assign(a, b, c)) return;
+        candidates.emit(candidate.view());
+        ++produced;
+    };
+
+    // Iterate through each base word
+    for (const StringView* it = base_begin; it != base_end; ++it) {
+        ThreadStats::add(stats.stages[STAT_COMBINE].produced, produced);
+        ThreadStats::add(stats.progress, 1);
+        produced = 0;
+        // Skip empty, non-printable or over-long base words
+        if (!is_printable(*it) || it->empty() || it->size() > CandidateBuffer::k_capacity) continue;
+        base.assign(*it, config.case_forms);
+        const std::string& b = base.original;
+        candidates.emit(b); // Always include the base word itself
+        ++produced;
+
+        // Combine with each piece of target info
+        for (const WordVariants& info : infos) {
+            const std::string& i = info.original;
+
+            // Simple combinations (base+info, info+base)
+            emit2(b, i);
+            emit2(i, b);
+
+            // --- Case Variations ---
+            // "Xb Xi"/"Xi Xb" equal "Xb i"/"i Xb" when the form leaves the info
+            // unchanged, and "Xb i"/"i Xb" equal "b i"/"i b" when it leaves the
+            // base unchanged, so those are skipped. A form whose base and info
+            // variants both repeat an earlier form's is skipped entirely.
+            for (size_t k = 0; k < form_count; ++k) {
+                if (base.first_equal[k] < k && base.first_equal[k] == info.first_equal[k]) continue;
+                const std::string& xb = base.forms[k];
+                const std::string& xi = info.forms[k];
+                if (!info.same[k]) {
+                    emit2(xb, xi); // CapBaseCapInfo
+                    emit2(xi, xb); // CapInfoCapBase
+                }
+                if (!base.same[k]) {
+                    emit2(xb, i); // CapBaseinfo
+                    emit2(i, xb); // infoCapBase
+                }
+            }
+
+            // Combinations with common suffixes
+            for (const std::string& suffix : suffixes) {
+                emit3(b, i, suffix);
+                emit3(i, b, suffix);
+                emit3(b, suffix, i); // Less common pattern, but possible
+                emit3(i, suffix, b); // Less common pattern, but possible
+
+                // Case variations with suffixes (same skipping rules as above)
+                for (size_t k = 0; k < form_count; ++k) {
+                    if (base.first_equal[k] < k && base.first_equal[k] == info.first_equal[k]) continue;
+                    const std::string& xb = base.forms[k];
+                    const std::string& xi = info.forms[k];
+                    if (!info.same[k]) {
+                        emit3(xb, xi, suffix);
+                        emit3(xi, xb, suffix);
+                    }
+                    if (!base.same[k]) {
+                        emit3(xb, i, suffix);
+                        emit3(i, xb, suffix);
+                    }
+                }
+            }
+        }
+
+        // Also combine the base word directly with suffixes
+        for (const std::string& suffix : suffixes) {
+            emit2(b, suffix); // baseSuffix
+            // Case-varied base word + suffix
+            for (size_t k = 0; k < form_count; ++k) {
+                if (base.same[k] || base.first_equal[k] < k) continue;
+                emit2(base.forms[k], suffix); // CapBaseSuffix
+            }
+        }
+    }
+    ThreadStats::add(stats.stages[STAT_COMBINE].produced, produced);
+}
+
+/**
+ * @brief Convenience overload over a whole base word list, with status messages.
+ */
+void generate_target_combinations(const std::vector<StringView>& base_words,
+                                  const std::vector<StringView>& target_info,
+                                  const CombinatorConfig& config,
+                                  CandidateSink& candidates) {
+    std::cerr << "[*] Generating target combinations..." << std::endl; // Use cerr for status messages
+    generate_target_combinations(base_words.data(), base_words.data() + base_words.size(),
+                                 target_info, config, candidates);
+    std::cerr << "[*] Finished target combinations." << std::endl;
+}
+
+/**
+ * @brief Single-byte substitution table used for leetspeak.
+ * The substitution map is stored as a 256-entry translation table (identity
+ * for unmapped bytes) and applied in a single pass. The table is laid out as
+ * sixteen 16-byte rows, one per high nibble, which is exactly the lookup
+ * table pshufb needs: with SSSE3 (16 bytes) or AVX2 (32 bytes per step) each
+ * block is translated by one shuffle-and-blend per row that contains a
+ * substitution (four rows for the default map), plus a scalar tail.
+ */
+class LeetTable {
+public:
+    /** @brief Creates an identity table (no substitutions). */
+    LeetTable() {
+        for (int i = 0; i < 256; ++i) table_[i] = static_cast<uint8_t>(i);
+    }
+
+    /**
+     * @brief The classic substitution list (case-insensitive):
+     * e->3, a->@, o->0, s->$, i->1, t->7
+     */
+    static LeetTable defaults() {
+        LeetTable table;
+        const char* pairs = "e3E3a@A@o0O0s$S$i1I1t7T7";
+        for (const char* p = pairs; *p; p += 2) table.set(p[0], p[1]);
+        return table;
+    }
+
+    /** @brief Maps byte from to byte to. */
+    void set(char from, char to) {
+        table_[static_cast<uint8_t>(from)] = static_cast<uint8_t>(to);
+        rows_.clear();
+        for (uint8_t row = 0; row < 16; ++row) {
+            for (int lo = 0; lo < 16; ++lo) {
+                if (table_[row * 16 + lo] != row * 16 + lo) {
+                    rows_.push_back(row);
+                    break;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Loads substitutions from a config file, replacing the current map.
+     * Each mapping line is "X Y" (source character, space or tab, replacement);
+     * blank lines and lines starting with '#' are comments, so '#' itself
+     * cannot be a source character (it can still be a replacement).
+     * @return false if the file could not be read or contained no valid mapping.
+     */
+    bool load(const std::string& path) {
+        Wordlist lines;
+        if (!lines.load(path)) return false;
+        *this = LeetTable();
+        size_t mappings = 0;
+        for (StringView line : lines) {
+            if (line[0] == '#') continue;
+            if (line.size() == 3 && (line[1] == ' ' || line[1] == '\t')) {
+                set(line[0], line[2]);
+                ++mappings;
+            } else {
+                std::cerr << "Warning: Ignoring leetspeak table line \"" << line.str()
+                          << "\" (expected \"X Y\")." << std::endl;
+            }
+        }
+        return mappings > 0;
+    }
+
+    /**
+     * @brief Enumerates leetspeak variants of a word by in-place byte patching.
+     * With k substitutable positions there are 2^k - 1 variants (every
+     * non-empty subset of positions). The fully substituted form comes first;
+     * the rest follow in Gray-code order, so each step flips exactly one bit
+     * of the subset mask and patches exactly one byte - no string is built per
+     * variant. Enumeration stops after max_variants variants, which keeps
+     * words with many substitutable characters (k >= 12) from exploding.
+     * Only the first 63 substitutable positions take part, and words longer
+     * than 256 bytes are left alone.
+     * @param word The word to patch; restored to its original bytes on return.
+     * @param size The word length.
+     * @param max_variants Maximum number of variants to report.
+     * @param on_variant Called (without arguments) while word holds each variant.
+     * @return The number of variants reported.
+     */
+    template <typename F>
+    size_t for_each_variant(char* word, size_t size, size_t max_variants, F on_variant) const {
+        if (max_variants == 0) return 0;
+        uint8_t positions[k_max_positions];
+        const unsigned k = substitutable_positions(word, size, positions);
+        if (k == 0) return 0;
+
+        uint8_t originals[k_max_positions];
+        for (unsigned j = 0; j < k; ++j) originals[j] = static_cast<uint8_t>(word[positions[j]]);
+
+        // The fully substituted form first (matches translate())
+        for (unsigned j = 0; j < k; ++j) word[positions[j]] = static_cast<char>(table_[originals[j]]);
+        on_variant();
+        size_t count = 1;
+        for (unsigned j = 0; j < k; ++j) word[positions[j]] = static_cast<char>(originals[j]);
+
+        // Partial forms in Gray-code order: step i flips bit ctz(i)
+        const uint64_t full_mask = (1ULL << k) - 1; // k <= 63
+        uint64_t mask = 0;
+        for (uint64_t i = 1; count < max_variants && i <= full_mask; ++i) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctzll(i));
+            const uint8_t pos = positions[bit];
+            mask ^= 1ULL << bit;
+            word[pos] = static_cast<char>((mask >> bit) & 1 ? table_[originals[bit]] : originals[bit]);
+            if (mask == full_mask) continue; // Already reported first
+            on_variant();
+            ++count;
+        }
+        for (unsigned j = 0; j < k; ++j) word[positions[j]] = static_cast<char>(originals[j]);
+        return count;
+    }
+
+    /**
+     * @brief Patches a word into its v-th leetspeak variant (random access).
+     * Produces the same variant for_each_variant() reports as number v
+     * (1-based): v = 1 is the fully substituted form, v > 1 the Gray-code
+     * sequence with the full mask skipped.
+     * @param word The word to patch in place.
+     * @param size The word length.
+     * @param v The variant number (>= 1).
+     * @return false if the word has fewer than v variants (word is left unchanged).
+     */
+    bool variant_at(char* word, size_t size, size_t v) const {
+        uint8_t positions[k_max_positions];
+        const unsigned k = substitutable_positions(word, size, positions);
+        const uint64_t full_mask = (1ULL << k) - 1; // Also the number of variants
+        if (k == 0 || v == 0 || v > full_mask) return false;
+        uint64_t mask = full_mask;
+        if (v > 1) {
+            uint64_t i = v - 1;
+            // Gray-code rank of the full mask, which the sequence skips
+            uint64_t full_rank = full_mask;
+            for (unsigned shift = 1; shift < 64; shift <<= 1) full_rank ^= full_rank >> shift;
+            if (i >= full_rank) ++i;
+            mask = i ^ (i >> 1);
+        }
+        for (unsigned j = 0; j < k; ++j) {
+            if ((mask >> j) & 1) {
+                char& c = word[positions[j]];
+                c = static_cast<char>(table_[static_cast<uint8_t>(c)]);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Translates size bytes from in to out (the ranges may be identical).
+     * @return true if at least one byte was substituted.
+     */
+    bool translate(const char* in, char* out, size_t size) const {
+        return cpu_kernels().translate(table_, rows_.data(), rows_.size(), reinterpret_cast<const uint8_t*>(in),
+                                       reinterpret_cast<uint8_t*>(out), size);
+    }
+
+    /** @return A hash of the substitution table (identifies it in checkpoints). */
+    uint64_t digest() const { return hash_bytes(reinterpret_cast<const char*>(table_), sizeof(table_)); }
+
+private:
+    static const unsigned k_max_positions = 63; // Substitutable positions considered per word
+
+    /**
+     * @brief Collects the positions of substitutable bytes (at most k_max_positions).
+     * Words longer than 256 bytes report none, since positions are stored in a byte.
+     * @return The number of positions written to positions.
+     */
+    unsigned substitutable_positions(const char* word, size_t size, uint8_t* positions) const {
+        if (size > 256) return 0;
+        unsigned k = 0;
+        for (size_t i = 0; i < size && k < k_max_positions; ++i) {
+            const uint8_t c = static_cast<uint8_t>(word[i]);
+            if (table_[c] != c) positions[k++] = static_cast<uint8_t>(i);
+        }
+        return k;
+    }
+
+    uint8_t table_[256];        // Translation table, row-major by high nibble
+    std::vector<uint8_t> rows_; // High nibbles whose row contains a substitution
+};
+
+/**
+ * @brief Applies leetspeak substitutions to every candidate of a set.
+ * See LeetTable::defaults() for the default substitution list.
+ * @param input The candidates to apply leetspeak to. candidates may insert into
+ *        this same set: only the candidates present at the start are visited.
+ * @param table The substitution table.
+ * @param max_variants Variants per word (1 = fully substituted form only).
+ * @param candidates The sink that receives the original words and their leetspeak versions.
+ */
+void apply_leetspeak(const CandidateSet& input,
+                       const LeetTable& table,
+                       size_t max_variants,
+                       CandidateSink& candidates) {
+    std::cerr << (max_variants > 1 ? "[*] Applying leetspeak permutations..." : "[*] Applying simple leetspeak...") << std::endl;
+    LeetspeakSink leet(table, max_variants, candidates);
+    // Iterate through each input word, in place (no copy of the set)
+    input.for_each_stable([&](StringView word) {
+        // Skip empty or non-printable words
+        if (!is_printable(word) || word.empty()) return;
+        leet.emit_variants(word); // The original word is in the set already
+    });
+     std::cerr << "[*] Finished leetspeak." << std::endl;
+}
+
+void LeetspeakSink::emit(StringView candidate) {
+    next_.emit(candidate); // Ensure original word is kept
+    emit_variants(candidate);
+}
+
+void LeetspeakSink::emit_variants(StringView candidate) {
+    if (!leet_word_.assign(candidate)) return; // Over-long: no variants
+    if (max_variants_ == 1) {
+        // Fully substituted form only: one vectorised pass
+        // Only emit the leetspeak version if it's different from the original
+        if (table_.translate(candidate.data(), leet_word_.data(), candidate.size())) {
+            ThreadStats::add(stats_.produced, 1);
+            next_.emit(leet_word_.view());
+        }
+        return;
+    }
+    // Partial forms: patch one byte per variant in the buffer
+    uint64_t variants = 0;
+    table_.for_each_variant(leet_word_.data(), leet_word_.size(), max_variants_,
+                            [this, &variants]() { ++variants; next_.emit(leet_word_.view()); });
+    ThreadStats::add(stats_.produced, variants);
+}
+
+/**
+ * @brief Order-k character Markov model with quantized levels (OMEN, Durmuth et al.).
+ * Trained on the base words and target info: the first k characters of a
+ * string (its prefix), every following character given the k before it (its
+ * context), and the string's length. Each probability is quantized to a level
+ * on a log scale fitted to the training size: -log2 p times
+ * k_max_level / log2(n), where n is the largest count total of any table, so
+ * the rarest observation lands at k_max_level whether the lists hold 50 or
+ * 50 million entries. A string's level is the sum of the levels of its prefix,
+ * transitions and length: lower means likelier. Events never observed get no
+ * level at all (k_unseen) and are not enumerated, so every string is made of
+ * trained n-grams and rare-but-seen events are not confused with unseen ones.
+ * Enumerating all strings of level 0, 1, 2, ... yields them in approximate
+ * probability order, and stopping at a level is a probability threshold.
+ *
+ * The tables are flat byte arrays over the alphabet seen in training (base-A
+ * numbers index contexts), and each context's characters are pre-sorted by
+ * level, so enumeration breaks out of a context as soon as the budget is spent.
+ * With k = 2 and 40-60 distinct characters both tables take 128-430 KiB and stay
+ * in L2 during enumeration.
+ */
+class MarkovModel {
+public:
+    static const unsigned k_max_order = 4;  // Longest context
+    static const uint8_t k_max_level = 10;  // Level of the least likely observed events
+    static const uint8_t k_unseen = 0xFF;   // Level of events never observed (not enumerated)
+    static const size_t k_max_length = 32;  // Longest string learned and enumerated
+
+    explicit MarkovModel(unsigned order) : order_(order), alphabet_size_(0), context_count_(1), max_length_(0) {}
+
+    /**
+     * @brief Learns the model from the printable strings of the given lists.
+     * @return false if no string of at least order() characters was found, or if
+     *         the tables would exceed max_table_bytes.
+     */
+    bool train(const std::vector<StringView>& base_words, const std::vector<StringView>& target_info,
+               size_t max_table_bytes) {
+        const std::vector<StringView>* lists[] = {&base_words, &target_info};
+        // The alphabet is every character that occurs, in byte order
+        bool seen[256] = {};
+        for (const std::vector<StringView>* list : lists) {
+            for (StringView word : *list) {
+                if (!usable(word)) continue;
+                for (size_t i = 0; i < word.size(); ++i) seen[static_cast<uint8_t>(word[i])] = true;
+            }
+        }
+        alphabet_.clear();
+        std::fill(index_, index_ + 256, 0);
+        for (int c = 0; c < 256; ++c) {
+            if (!seen[c]) continue;
+            index_[c] = static_cast<uint8_t>(alphabet_.size());
+            alphabet_.push_back(static_cast<char>(c));
+        }
+        alphabet_size_ = alphabet_.size();
+        context_count_ = 1;
+        for (unsigned i = 0; i < order_; ++i) context_count_ *= alphabet_size_;
+        if (alphabet_size_ == 0 || table_bytes() > max_table_bytes) return false;
+
+        std::vector<uint32_t> initial(context_count_, 0);
+        std::vector<uint32_t> transitions(context_count_ * alphabet_size_, 0);
+        std::vector<uint32_t> lengths(k_max_length + 1, 0);
+        uint64_t strings = 0;
+        for (const std::vector<StringView>* list : lists) {
+            for (StringView word : *list) {
+                if (!usable(word) || word.size() < order_) continue;
+                size_t context = 0;
+                for (size_t i = 0; i < order_; ++i) context = context * alphabet_size_ + index_[static_cast<uint8_t>(word[i])];
+                ++initial[context];
+                for (size_t i = order_; i < word.size(); ++i) {
+                    const uint8_t c = index_[static_cast<uint8_t>(word[i])];
+                    ++transitions[context * alphabet_size_ + c];
+                    context = (context * alphabet_size_ + c) % context_count_;
+                }
+                ++lengths[word.size()];
+                ++strings;
+            }
+        }
+        if (strings == 0) return false;
+
+        // The level scale spans the largest table, so its rarest event is at k_max_level
+        std::vector<uint64_t> context_totals(context_count_, 0);
+        uint64_t largest_total = strings;
+        for (size_t context = 0; context < context_count_; ++context) {
+            const uint32_t* counts = &transitions[context * alphabet_size_];
+            for (size_t c = 0; c < alphabet_size_; ++c) context_totals[context] += counts[c];
+            largest_total = std::max(largest_total, context_totals[context]);
+        }
+        const double scale = k_max_level / std::log2(static_cast<double>(std::max<uint64_t>(largest_total, 2)));
+
+        initial_.resize(context_count_);
+        for (size_t p = 0; p < context_count_; ++p) initial_[p] = quantize(initial[p], strings, scale);
+        length_.assign(k_max_length + 1, k_unseen);
+        max_length_ = 0;
+        for (size_t n = std::max<size_t>(order_, 1); n <= k_max_length; ++n) {
+            length_[n] = quantize(lengths[n], strings, scale);
+            if (lengths[n] != 0) max_length_ = n;
+        }
+        transition_.resize(context_count_ * alphabet_size_);
+        order_by_level_.resize(context_count_ * alphabet_size_);
+        for (size_t context = 0; context < context_count_; ++context) {
+            const uint32_t* counts = &transitions[context * alphabet_size_];
+            uint8_t* levels = &transition_[context * alphabet_size_];
+            uint8_t* sorted = &order_by_level_[context * alphabet_size_];
+            for (size_t c = 0; c < alphabet_size_; ++c) {
+                levels[c] = quantize(counts[c], context_totals[context], scale);
+                sorted[c] = static_cast<uint8_t>(c);
+            }
+            std::stable_sort(sorted, sorted + alphabet_size_, [levels](uint8_t a, uint8_t b) { return levels[a] < levels[b]; });
+        }
+        return true;
+    }
+
+    /** @return The context length k. */
+    unsigned order() const { return order_; }
+    /** @return The number of distinct characters. */
+    size_t alphabet_size() const { return alphabet_size_; }
+    /** @return The number of prefixes (alphabet_size()^order()), the unit of parallel work. */
+    size_t prefix_count() const { return context_count_; }
+    /** @return The longest training string (up to k_max_length); nothing longer is enumerated. */
+    size_t max_length() const { return max_length_; }
+    /** @return Bytes of the prefix and transition tables (the transition order table doubles the latter). */
+    size_t table_bytes() const { return context_count_ + 2 * context_count_ * alphabet_size_; }
+
+    /**
+     * @brief Calls emit(candidate) for every string of exactly the given level
+     * that starts with prefix, shortest strings first.
+     * @param level The level to enumerate.
+     * @param prefix Index of the first order() characters, in [0, prefix_count()).
+     * @param emit Returns false to stop the enumeration.
+     * @return false if emit stopped it.
+     */
+    template <typename F>
+    bool enumerate(unsigned level, size_t prefix, F emit) const {
+        char text[k_max_length];
+        for (size_t i = order_, p = prefix; i-- > 0; p /= alphabet_size_) text[i] = alphabet_[p % alphabet_size_];
+        if (initial_[prefix] == k_unseen || initial_[prefix] > level) return true;
+        const unsigned after_prefix = level - initial_[prefix];
+        for (size_t length = std::max<size_t>(order_, 1); length <= max_length_; ++length) {
+            if (length_[length] == k_unseen || length_[length] > after_prefix) continue;
+            const unsigned budget = after_prefix - length_[length];
+            if (length == order_) {
+                if (budget == 0 && !emit(StringView(text, length))) return false;
+                continue;
+            }
+            if (budget > (length - order_) * k_max_level) continue;
+            if (!extend(text, order_, length, prefix, budget, emit)) return false;
+        }
+        return true;
+    }
+
+private:
+    /** @brief Strings the model learns from and can produce. */
+    static bool usable(StringView word) { return !word.empty() && word.size() <= k_max_length && is_printable(word); }
+
+    /**
+     * @brief Level of count out of total: floor(-log2 p * scale), capped at k_max_level.
+     * @return k_unseen for an event that was never observed.
+     */
+    static uint8_t quantize(uint64_t count, uint64_t total, double scale) {
+        if (count == 0) return k_unseen;
+        const double p = static_cast<double>(count) / static_cast<double>(total);
+        // The epsilon keeps exact powers of the scale from rounding down a level
+        return static_cast<uint8_t>(std::min<double>(k_max_level, std::floor(-std::log2(p) * scale + 1e-9)));
+    }
+
+    /** @brief Fills text[position, length) with transitions whose levels sum to exactly budget. */
+    template <typename F>
+    bool extend(char* text, size_t position, size_t length, size_t context, unsigned budget, F& emit) const {
+        const uint8_t* levels = &transition_[context * alphabet_size_];
+        const uint8_t* sorted = &order_by_level_[context * alphabet_size_];
+        const size_t remaining = length - position - 1; // Positions after this one
+        for (size_t i = 0; i < alphabet_size_; ++i) {
+            const uint8_t c = sorted[i];
+            const unsigned level = levels[c];
+            if (level == k_unseen || level > budget) break; // Sorted by level: nothing further fits
+            const unsigned rest = budget - level;
+            if (rest > remaining * k_max_level) continue;
+            text[position] = alphabet_[c];
+            if (remaining == 0) {
+                if (!emit(StringView(text, length))) return false;
+            } else if (!extend(text, position + 1, length, (context * alphabet_size_ + c) % context_count_, rest, emit)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    unsigned order_;                     // k
+    std::string alphabet_;               // Index -> character
+    uint8_t index_[256];                 // Character -> index
+    size_t alphabet_size_;               // A
+    size_t context_count_;               // A^k
+    size_t max_length_;                  // Longest string enumerated
+    std::vector<uint8_t> initial_;       // Prefix -> level
+    std::vector<uint8_t> length_;        // Length -> level
+    std::vector<uint8_t> transition_;    // context * A + c -> level
+    std::vector<uint8_t> order_by_level_; // context * A + i -> i-th likeliest character
+};
+
+/**
+ * @brief Emits every Markov string of one level that starts with one prefix.
+ * The unit of work of stream_markov(); strings come out in no particular
+ * probability order within the level.
+ * @param model The trained model.
+ * @param level The level to enumerate.
+ * @param prefix Index of the first model.order() characters.
+ * @param candidates The sink that receives the strings.
+ * @param done Called after every string; the enumeration ends once it returns true.
+ */
+template <typename Done>
+void generate_markov(const MarkovModel& model, unsigned level, size_t prefix, CandidateSink& candidates, Done done) {
+    ThreadStats& stats = Stats::local();
+    uint64_t produced = 0;
+    model.enumerate(level, prefix, [&](StringView candidate) {
+        candidates.emit(candidate);
+        ++produced;
+        return !done();
+    });
+    ThreadStats::add(stats.stages[STAT_COMBINE].produced, produced);
+    ThreadStats::add(stats.progress, produced);
+}
+
+// --- Rule Engine ---
+
+/**
+ * @brief Opcodes of the compiled rule bytecode.
+ * Each instruction is one opcode byte followed by its operand bytes (positions
+ * are pre-decoded to 0..35, characters stored verbatim). Every compiled rule
+ * ends with OP_END.
+ */
+enum RuleOp : uint8_t {
+    OP_END,              // End of rule
+    OP_LOWER,            // l
+    OP_UPPER,            // u
+    OP_CAPITALIZE,       // c
+    OP_INV_CAPITALIZE,   // C
+    OP_TOGGLE_ALL,       // t
+    OP_TOGGLE_AT,        // TN
+    OP_REVERSE,          // r
+    OP_DUPLICATE,        // d
+    OP_DUPLICATE_N,      // pN
+    OP_REFLECT,          // f
+    OP_ROTATE_LEFT,      // {
+    OP_ROTATE_RIGHT,     // }
+    OP_APPEND,           // $X
+    OP_PREPEND,          // ^X
+    OP_DELETE_FIRST,     // [
+    OP_DELETE_LAST,      // ]
+    OP_DELETE_AT,        // DN
+    OP_EXTRACT,          // xNM
+    OP_OMIT,             // ONM
+    OP_INSERT,           // iNX
+    OP_OVERWRITE,        // oNX
+    OP_TRUNCATE,         // 'N
+    OP_REPLACE,          // sXY
+    OP_PURGE,            // @X
+    OP_DUP_FIRST,        // zN
+    OP_DUP_LAST,         // ZN
+    OP_DUP_EVERY,        // q
+    OP_SWAP_FRONT,       // k
+    OP_SWAP_BACK,        // K
+    OP_SWAP_AT,          // *NM
+    OP_SHIFT_LEFT,       // LN
+    OP_SHIFT_RIGHT,      // RN
+    OP_INCREMENT,        // +N
+    OP_DECREMENT,        // -N
+    OP_REPLACE_NEXT,     // .N
+    OP_REPLACE_PREV,     // ,N
+    OP_DUP_BLOCK_FRONT,  // yN
+    OP_DUP_BLOCK_BACK,   // YN
+    OP_TITLE,            // E
+    OP_TITLE_SEP,        // eX
+    OP_REJECT_LONGER,    // <N  (reject if length > N)
+    OP_REJECT_SHORTER,   // >N  (reject if length < N)
+    OP_REJECT_UNLESS_LEN,// _N
+    OP_REJECT_CONTAIN,   // !X
+    OP_REJECT_NOT_CONTAIN, // /X
+    OP_REJECT_NOT_FIRST, // (X
+    OP_REJECT_NOT_LAST,  // )X
+    OP_REJECT_NOT_AT,    // =NX
+    OP_REJECT_FEWER      // %NX
+};
+
+/**
+ * @brief A list of hashcat/John the Ripper style rules compiled to bytecode.
+ * All rules share one flat code array; apply() runs a rule with a small
+ * switch-dispatched interpreter over a fixed-size caller-provided buffer, so
+ * applying rules never allocates. Supported functions:
+ *   : l u c C t TN r d pN f { } $X ^X [ ] DN xNM ONM iNX oNX 'N sXY @X zN ZN q
+ *   k K *NM LN RN +N -N .N ,N yN YN E eX and the rejections <N >N _N !X /X (X )X =NX %NX
+ * Positions N/M are 0-9 then A-Z (10-35). Spaces between functions are ignored.
+ * Where hashcat and John the Ripper disagree, hashcat wins: <N rejects words
+ * longer than N and >N words shorter than N, and xNM/ONM leave the word
+ * unchanged when the span does not fit.
+ */
+class RuleSet {
+public:
+    /** Maximum candidate length handled by the interpreter (hashcat's limit). */
+    static const size_t k_buffer_size = 256;
+
+    /**
+     * @brief Compiles one rule and appends it to the set.
+     * @param rule The rule text, e.g. "c $1 $2".
+     * @param error Receives a description of the problem if compilation fails.
+     * @return true if the rule compiled.
+     */
+    bool add(const char* rule, size_t size, std::string& error) {
+        const size_t start = code_.size();
+        const char* p = rule;
+        const char* end = rule + size;
+        // Operand readers: a position (0-9, A-Z) or any single character
+        auto position = [&](uint8_t& out) -> bool {
+            if (p >= end) return false;
+            char c = *p++;
+            if (c >= '0' && c <= '9') out = static_cast<uint8_t>(c - '0');
+            else if (c >= 'A' && c <= 'Z') out = static_cast<uint8_t>(c - 'A' + 10);
+            else return false;
+            return true;
+        };
+        auto character = [&](uint8_t& out) -> bool {
+            if (p >= end) return false;
+            out = static_cast<uint8_t>(*p++);
+            return true;
+        };
+
+        while (p < end) {
+            const char function = *p++;
+            uint8_t a = 0, b = 0;
+            bool ok = true;
+            switch (function) {
+            case ' ': case '\t': case ':': continue;
+            case 'l': emit(OP_LOWER); break;
+            case 'u': emit(OP_UPPER); break;
+            case 'c': emit(OP_CAPITALIZE); break;
+            case 'C': emit(OP_INV_CAPITALIZE); break;
+            case 't': emit(OP_TOGGLE_ALL); break;
+            case 'r': emit(OP_REVERSE); break;
+            case 'd': emit(OP_DUPLICATE); break;
+            case 'f': emit(OP_REFLECT); break;
+            case '{': emit(OP_ROTATE_LEFT); break;
+            case '}': emit(OP_ROTATE_RIGHT); break;
+            case '[': emit(OP_DELETE_FIRST); break;
+            case ']': emit(OP_DELETE_LAST); break;
+            case 'q': emit(OP_DUP_EVERY); break;
+            case 'k': emit(OP_SWAP_FRONT); break;
+            case 'K': emit(OP_SWAP_BACK); break;
+            case 'E': emit(OP_TITLE); break;
+            case 'T': ok = position(a); emit(OP_TOGGLE_AT, a); break;
+            case 'p': ok = position(a); emit(OP_DUPLICATE_N, a); break;
+            case 'D': ok = position(a); emit(OP_DELETE_AT, a); break;
+            case '\'': ok = position(a); emit(OP_TRUNCATE, a); break;
+            case 'z': ok = position(a); emit(OP_DUP_FIRST, a); break;
+            case 'Z': ok = position(a); emit(OP_DUP_LAST, a); break;
+            case 'L': ok = position(a); emit(OP_SHIFT_LEFT, a); break;
+            case 'R': ok = position(a); emit(OP_SHIFT_RIGHT, a); break;
+            case '+': ok = position(a); emit(OP_INCREMENT, a); break;
+            case '-': ok = position(a); emit(OP_DECREMENT, a); break;
+            case '.': ok = position(a); emit(OP_REPLACE_NEXT, a); break;
+            case ',': ok = position(a); emit(OP_REPLACE_PREV, a); break;
+            case 'y': ok = position(a); emit(OP_DUP_BLOCK_FRONT, a); break;
+            case 'Y': ok = position(a); emit(OP_DUP_BLOCK_BACK, a); break;
+            case '<': ok = position(a); emit(OP_REJECT_LONGER, a); break;
+            case '>': ok = position(a); emit(OP_REJECT_SHORTER, a); break;
+            case '_': ok = position(a); emit(OP_REJECT_UNLESS_LEN, a); break;
+            case '$': ok = character(a); emit(OP_APPEND, a); break;
+            case '^': ok = character(a); emit(OP_PREPEND, a); break;
+            case '@': ok = character(a); emit(OP_PURGE, a); break;
+            case 'e': ok = character(a); emit(OP_TITLE_SEP, a); break;
+            case '!': ok = character(a); emit(OP_REJECT_CONTAIN, a); break;
+            case '/': ok = character(a); emit(OP_REJECT_NOT_CONTAIN, a); break;
+            case '(': ok = character(a); emit(OP_REJECT_NOT_FIRST, a); break;
+            case ')': ok = character(a); emit(OP_REJECT_NOT_LAST, a); break;
+            case 'x': ok = position(a) && position(b); emit(OP_EXTRACT, a, b); break;
+            case 'O': ok = position(a) && position(b); emit(OP_OMIT, a, b); break;
+            case '*': ok = position(a) && position(b); emit(OP_SWAP_AT, a, b); break;
+            case 'i': ok = position(a) && character(b); emit(OP_INSERT, a, b); break;
+            case 'o': ok = position(a) && character(b); emit(OP_OVERWRITE, a, b); break;
+            case '=': ok = position(a) && character(b); emit(OP_REJECT_NOT_AT, a, b); break;
+            case '%': ok = position(a) && character(b); emit(OP_REJECT_FEWER, a, b); break;
+            case 's': ok = character(a) && character(b); emit(OP_REPLACE, a, b); break;
+            default:
+                error = std::string("unsupported rule function '") + function + "'";
+                code_.resize(start);
+                return false;
+            }
+            if (!ok) {
+                error = std::string("missing or invalid argument for '") + function + "'";
+                code_.resize(start);
+                return false;
+            }
+        }
+        emit(OP_END);
+        starts_.push_back(static_cast<uint32_t>(start));
+        return true;
+    }
+
+    bool add(const std::string& rule, std::string& error) { return add(rule.data(), rule.size(), error); }
+
+    /**
+     * @brief Loads and compiles a rule file (one rule per line).
+     * Blank lines and lines starting with '#' are skipped; rules that fail to
+     * compile are reported on stderr and skipped.
+     * @param path The rule file.
+     * @return false if the file could not be read.
+     */
+    bool load(const std::string& path) {
+        Wordlist lines;
+        if (!lines.load(path)) return false;
+        size_t rejected = 0;
+        for (StringView line : lines) {
+            if (line[0] == '#') continue;
+            std::string error;
+            if (!add(line.data(), line.size(), error)) {
+                if (++rejected <= 10) {
+                    std::cerr << "Warning: Skipping rule \"" << line.str() << "\": " << error << std::endl;
+                }
+            }
+        }
+        if (rejected > 10) {
+            std::cerr << "Warning: Skipped " << rejected << " rules in total from " << path << "." << std::endl;
+        }
+        return true;
+    }
+
+    /** @return The number of compiled rules. */
+    size_t size() const { return starts_.size(); }
+    bool empty() const { return starts_.empty(); }
+
+    /** @return A hash of the compiled rules (identifies the rule set in checkpoints). */
+    uint64_t digest() const {
+        return hash_bytes(reinterpret_cast<const char*>(code_.data()), code_.size()) ^ starts_.size();
+    }
+
+    /**
+     * @brief Runs one rule over a word.
+     * @param rule Index of the rule (0 <= rule < size()).
+     * @param word Input bytes.
+     * @param size Input length.
+     * @param out Output buffer of at least k_buffer_size bytes.
+     * @return The output length, or -1 if the rule rejected the word or the
+     *         result would exceed k_buffer_size.
+     */
+    int apply(size_t rule, const char* word, size_t size, char* out) const {
+        if (size > k_buffer_size) return -1;
+        std::memcpy(out, word, size);
+        size_t len = size;
+        const size_t cap = k_buffer_size;
+        const uint8_t* pc = code_.data() + starts_[rule];
+
+        for (;;) {
+            const uint8_t op = *pc++;
+            switch (op) {
+            case OP_END:
+                return static_cast<int>(len);
+            case OP_LOWER:
+                for (size_t i = 0; i < len; ++i) out[i] = to_lower(out[i]);
+                break;
+            case OP_UPPER:
+                for (size_t i = 0; i < len; ++i) out[i] = to_upper(out[i]);
+                break;
+            case OP_CAPITALIZE:
+                for (size_t i = 0; i < len; ++i) out[i] = (i == 0) ? to_upper(out[i]) : to_lower(out[i]);
+                break;
+            case OP_INV_CAPITALIZE:
+                for (size_t i = 0; i < len; ++i) out[i] = (i == 0) ? to_lower(out[i]) : to_upper(out[i]);
+                break;
+            case OP_TOGGLE_ALL:
+                for (size_t i = 0; i < len; ++i) out[i] = toggle(out[i]);
+                break;
+            case OP_TOGGLE_AT: {
+                const size_t n = *pc++;
+                if (n < len) out[n] = toggle(out[n]);
+                break;
+            }
+            case OP_REVERSE:
+                std::reverse(out, out + len);
+                break;
+            case OP_DUPLICATE:
+                if (len * 2 > cap) return -1;
+                std::memcpy(out + len, out, len);
+                len *= 2;
+                break;
+            case OP_DUPLICATE_N: {
+                const size_t n = *pc++;
+                if (len * (n + 1) > cap) return -1;
+                for (size_t k = 1; k <= n; ++k) std::memcpy(out + len * k, out, len);
+                len *= n + 1;
+                break;
+            }
+            case OP_REFLECT:
+                if (len * 2 > cap) return -1;
+                for (size_t i = 0; i < len; ++i) out[len + i] = out[len - 1 - i];
+                len *= 2;
+                break;
+            case OP_ROTATE_LEFT:
+                if (len > 1) std::rotate(out, out + 1, out + len);
+                break;
+            case OP_ROTATE_RIGHT:
+                if (len > 1) std::rotate(out, out + len - 1, out + len);
+                break;
+            case OP_APPEND:
+                if (len + 1 > cap) return -1;
+                out[len++] = static_cast<char>(*pc++);
+                break;
+            case OP_PREPEND:
+                if (len + 1 > cap) return -1;
+                std::memmove(out + 1, out, len);
+                out[0] = static_cast<char>(*pc++);
+                ++len;
+                break;
+            case OP_DELETE_FIRST:
+                if (len > 0) std::memmove(out, out + 1, --len);
+                break;
+            case OP_DELETE_LAST:
+                if (len > 0) --len;
+                break;
+            case OP_DELETE_AT: {
+                const size_t n = *pc++;
+                if (n < len) {
+                    std::memmove(out + n, out + n + 1, len - n - 1);
+                    --len;
+                }
+                break;
+            }
+            case OP_EXTRACT: {
+                const size_t n = pc[0], m = pc[1];
+                pc += 2;
+                if (n < len && n + m <= len) { // Out of range: the word is left as it is (hashcat)
+                    std::memmove(out, out + n, m);
+                    len = m;
+                }
+                break;
+            }
+            case OP_OMIT: {
+                const size_t n = pc[0], m = pc[1];
+                pc += 2;
+                if (n < len && n + m <= len) { // Out of range: the word is left as it is (hashcat)
+                    std::memmove(out + n, out + n + m, len - n - m);
+                    len -= m;
+                }
+                break;
+            }
+            case OP_INSERT: {
+                const size_t n = pc[0];
+                const char x = static_cast<char>(pc[1]);
+                pc += 2;
+                if (n <= len) {
+                    if (len + 1 > cap) return -1;
+                    std::memmove(out + n + 1, out + n, len - n);
+                    out[n] = x;
+                    ++len;
+                }
+                break;
+            }
+            case OP_OVERWRITE: {
+                const size_t n = pc[0];
+                if (n < len) out[n] = static_cast<char>(pc[1]);
+                pc += 2;
+                break;
+            }
+            case OP_TRUNCATE: {
+                const size_t n = *pc++;
+                if (n < len) len = n;
+                break;
+            }
+            case OP_REPLACE: {
+                const char x = static_cast<char>(pc[0]), y = static_cast<char>(pc[1]);
+                pc += 2;
+                for (size_t i = 0; i < len; ++i) if (out[i] == x) out[i] = y;
+                break;
+            }
+            case OP_PURGE: {
+                const char x = static_cast<char>(*pc++);
+                len = static_cast<size_t>(std::remove(out, out + len, x) - out);
+                break;
+            }
+            case OP_DUP_FIRST: {
+                const size_t n = *pc++;
+                if (len == 0) break;
+                if (len + n > cap) return -1;
+                std::memmove(out + n, out, len);
+                std::memset(out, out[n], n);
+                len += n;
+                break;
+            }
+            case OP_DUP_LAST: {
+                const size_t n = *pc++;
+                if (len == 0) break;
+                if (len + n > cap) return -1;
+                std::memset(out + len, out[len - 1], n);
+                len += n;
+                break;
+            }
+            case OP_DUP_EVERY:
+                if (len * 2 > cap) return -1;
+                for (size_t i = len; i-- > 0;) {
+                    out[2 * i] = out[i];
+                    out[2 * i + 1] = out[i];
+                }
+                len *= 2;
+                break;
+            case OP_SWAP_FRONT:
+                if (len >= 2) std::swap(out[0], out[1]);
+                break;
+            case OP_SWAP_BACK:
+                if (len >= 2) std::swap(out[len - 1], out[len - 2]);
+                break;
+            case OP_SWAP_AT: {
+                const size_t n = pc[0], m = pc[1];
+                pc += 2;
+                if (n < len && m < len) std::swap(out[n], out[m]);
+                break;
+            }
+            case OP_SHIFT_LEFT: {
+                const size_t n = *pc++;
+                if (n < len) out[n] = static_cast<char>(static_cast<unsigned char>(out[n]) << 1);
+                break;
+            }
+            case OP_SHIFT_RIGHT: {
+                const size_t n = *pc++;
+                if (n < len) out[n] = static_cast<char>(static_cast<unsigned char>(out[n]) >> 1);
+                break;
+            }
+            case OP_INCREMENT: {
+                const size_t n = *pc++;
+                if (n < len) ++out[n];
+                break;
+            }
+            case OP_DECREMENT: {
+                const size_t n = *pc++;
+                if (n < len) --out[n];
+                break;
+            }
+            case OP_REPLACE_NEXT: {
+                const size_t n = *pc++;
+                if (n + 1 < len) out[n] = out[n + 1];
+                break;
+            }
+            case OP_REPLACE_PREV: {
+                const size_t n = *pc++;
+                if (n >= 1 && n < len) out[n] = out[n - 1];
+                break;
+            }
+            case OP_DUP_BLOCK_FRONT: {
+                const size_t n = *pc++;
+                if (n > len) break;
+                if (len + n > cap) return -1;
+                std::memmove(out + n, out, len);
+                len += n; // out[0..n) still holds the original first n characters
+                break;
+            }
+            case OP_DUP_BLOCK_BACK: {
+                const size_t n = *pc++;
+                if (n > len) break;
+                if (len + n > cap) return -1;
+                std::memcpy(out + len, out + len - n, n);
+                len += n;
+                break;
+            }
+            case OP_TITLE:
+                title_case(out, len, ' ');
+                break;
+            case OP_TITLE_SEP:
+                title_case(out, len, static_cast<char>(*pc++));
+                break;
+            case OP_REJECT_LONGER:
+                if (len > *pc++) return -1;
+                break;
+            case OP_REJECT_SHORTER:
+                if (len < *pc++) return -1;
+                break;
+            case OP_REJECT_UNLESS_LEN:
+                if (len != *pc++) return -1;
+                break;
+            case OP_REJECT_CONTAIN:
+                if (std::memchr(out, *pc++, len) != nullptr) return -1;
+                break;
+            case OP_REJECT_NOT_CONTAIN:
+                if (std::memchr(out, *pc++, len) == nullptr) return -1;
+                break;
+            case OP_REJECT_NOT_FIRST:
+                if (len == 0 || out[0] != static_cast<char>(*pc++)) return -1;
+                break;
+            case OP_REJECT_NOT_LAST:
+                if (len == 0 || out[len - 1] != static_cast<char>(*pc++)) return -1;
+                break;
+            case OP_REJECT_NOT_AT: {
+                const size_t n = pc[0];
+                const char x = static_cast<char>(pc[1]);
+                pc += 2;
+                if (n >= len || out[n] != x) return -1;
+                break;
+            }
+            case OP_REJECT_FEWER: {
+                const size_t n = pc[0];
+                const char x = static_cast<char>(pc[1]);
+                pc += 2;
+                if (static_cast<size_t>(std::count(out, out + len, x)) < n) return -1;
+                break;
+            }
+            default:
+                return -1; // Not reachable for code produced by add()
+            }
+        }
+    }
+
+private:
+    void emit(uint8_t op) { code_.push_back(op); }
+    void emit(uint8_t op, uint8_t a) { code_.push_back(op); code_.push_back(a); }
+    void emit(uint8_t op, uint8_t a, uint8_t b) { code_.push_back(op); code_.push_back(a); code_.push_back(b); }
+
+    static char to_lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c; }
+    static char to_upper(char c) { return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 32) : c; }
+    static char toggle(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 32)
+             : (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c;
+    }
+    /** @brief Lowercases everything, then uppercases the first letter and every letter after sep. */
+    static void title_case(char* out, size_t len, char sep) {
+        for (size_t i = 0; i < len; ++i) {
+            out[i] = (i == 0 || out[i - 1] == sep) ? to_upper(out[i]) : to_lower(out[i]);
+        }
+    }
+
+    std::vector<uint8_t> code_;    // Bytecode of all rules, each terminated by OP_END
+    std::vector<uint32_t> starts_; // Offset of each rule in code_
+};
+
+/**
+ * @brief Sink decorator that runs every rule of a RuleSet over each candidate.
+ * Like hashcat -r, only the rule outputs are forwarded (use a ':' rule to keep
+ * the unmodified candidate). Rules run in a stack buffer that is forwarded as
+ * a view, so nothing is allocated.
+ */
+class RuleSink : public CandidateSink {
+public:
+    RuleSink(const RuleSet& rules, CandidateSink& next)
+        : rules_(rules), next_(next), stats_(Stats::local().stages[STAT_RULES]) {}
+
+    void emit(StringView candidate) override {
+        char buffer[RuleSet::k_buffer_size];
+        uint64_t rejected = 0;
+        for (size_t r = 0; r < rules_.size(); ++r) {
+            const int len = rules_.apply(r, candidate.data(), candidate.size(), buffer);
+            if (len <= 0) { // Rejected, or nothing left
+                ++rejected;
+                continue;
+            }
+            next_.emit(StringView(buffer, static_cast<size_t>(len)));
+        }
+        ThreadStats::add(stats_.produced, rules_.size() - rejected);
+        ThreadStats::add(stats_.rejected, rejected);
+    }
+
+private:
+    const RuleSet& rules_;
+    CandidateSink& next_;
+    ThreadStats::Counters& stats_; // Rule counters of the owning thread
+};
+
+/**
+ * @brief Applies a rule set to every candidate of a set, collecting the results.
+ * @param input The candidates to transform.
+ * @param rules The compiled rules.
+ * @param candidates The sink that receives the rule outputs.
+ */
+void apply_rules(const CandidateSet& input, const RuleSet& rules, CandidateSink& candidates) {
+    std::cerr << "[*] Applying " << rules.size() << " rules..." << std::endl;
+    RuleSink rule_sink(rules, candidates);
+    input.for_each([&](StringView candidate) { rule_sink.emit(candidate); });
+    std::cerr << "[*] Finished rules." << std::endl;
+}
+
+/**
+ * @brief Settings for the per-candidate transform stages (leetspeak, rules).
+ */
+struct TransformConfig {
+    const LeetTable* leet = nullptr; // Add the leetspeak variants of every candidate (nullptr = off)
+    size_t leet_max_variants = 1;    // Variants per candidate (1 = fully substituted form only)
+    const RuleSet* rules = nullptr; // Rules applied to every candidate (nullptr = none)
+    const XorFilter* exclude = nullptr; // Candidates to suppress after the transforms (nullptr = none)
+};
+
+/**
+ * @brief Chain of transform sinks in front of an output sink.
+ * Candidates fed to input() pass through leetspeak, the rules and the
+ * exclusion filter (each if configured) before reaching the output sink.
+ */
+class TransformChain {
+public:
+    TransformChain(const TransformConfig& config, CandidateSink& output) : input_(&output) {
+        if (config.exclude != nullptr) {
+            exclude_.reset(new ExcludeSink(*config.exclude, *input_));
+            input_ = exclude_.get();
+        }
+        if (config.rules != nullptr) {
+            rules_.reset(new RuleSink(*config.rules, *input_));
+            input_ = rules_.get();
+        }
+        if (config.leet != nullptr) {
+            leet_.reset(new LeetspeakSink(*config.leet, config.leet_max_variants, *input_));
+            input_ = leet_.get();
+        }
+    }
+
+    /** @return The sink that generation strategies should write to. */
+    CandidateSink& input() { return *input_; }
+
+private:
+    std::unique_ptr<ExcludeSink> exclude_;
+    std::unique_ptr<RuleSink> rules_;
+    std::unique_ptr<LeetspeakSink> leet_;
+    CandidateSink* input_;
+};
+
+// --- Keyspace ---
+
+/**
+ * @brief Shape of a combination slot: which parts it joins and in what order.
+ */
+enum Pattern {
+    PATTERN_BASE,             // base
+    PATTERN_BASE_INFO,        // base info
+    PATTERN_INFO_BASE,        // info base
+    PATTERN_BASE_INFO_SUFFIX, // base info suffix
+    PATTERN_INFO_BASE_SUFFIX, // info base suffix
+    PATTERN_BASE_SUFFIX_INFO, // base suffix info
+    PATTERN_INFO_SUFFIX_BASE, // info suffix base
+    PATTERN_BASE_SUFFIX,      // base suffix
+    PATTERN_COUNT
+};
+
+const char* const k_pattern_names[PATTERN_COUNT] = {
+    "base", "base_info", "info_base", "base_info_suffix", "info_base_suffix",
+    "base_suffix_info", "info_suffix_base", "base_suffix"};
+
+/**
+ * @brief Everything that distinguishes one combination slot from another.
+ */
+struct SlotShape {
+    static const size_t k_none = ~static_cast<size_t>(0);
+
+    Pattern pattern = PATTERN_BASE;
+    size_t info = k_none;   // Target info entry (k_none if the pattern has none)
+    size_t suffix = k_none; // Suffix (k_none if the pattern has none)
+    size_t form = k_none;   // Case form applied to the base word (k_none = original spelling)
+};
+
+/**
+ * @brief Mixed-radix model of everything the generator can emit.
+ * The combinator output of generate_target_combinations() followed by the
+ * transform chain is laid out as a fixed grid:
+ *
+ *   index = ((base * W + slot) * L + leet) * R + rule
+ *
+ * W is the number of combination slots per base word (the base word itself,
+ * then for every target info entry 2 + 4F plain/case slots and 4 + 4F slots
+ * per suffix, then 1 + F base+suffix slots per suffix; F = case forms),
+ * L = 1 + leetspeak variants per candidate and R = number of rules (1 without
+ * a rule file). Enumerating indices in order reproduces the streaming output
+ * order exactly. Positions whose candidate would be redundant (a case form that
+ * does not change the word, a leetspeak variant a word does not have, a rule
+ * rejection, an excluded candidate) are holes: they count towards the keyspace but emit nothing, in
+ * the same way hashcat's keyspace counts words x rules.
+ * The model is immutable and can be shared between threads; decoding happens
+ * in a KeyspaceCursor.
+ */
+class Keyspace {
+public:
+    /**
+     * @param base_words The base words (empty and non-printable entries are ignored).
+     * @param target_info The target-specific strings (likewise filtered).
+     * @param config Suffixes and case forms.
+     * @param transforms Leetspeak and rule stages.
+     */
+    Keyspace(const std::vector<StringView>& base_words,
+             const std::vector<StringView>& target_info,
+             const CombinatorConfig& config,
+             const TransformConfig& transforms)
+        : config_(config), transforms_(transforms), overflow_(false) {
+        for (StringView word : base_words) {
+            if (is_printable(word) && !word.empty()) bases_.push_back(word);
+        }
+        for (StringView info : target_info) {
+            if (!is_printable(info) || info.empty()) continue;
+            infos_.push_back(WordVariants());
+            infos_.back().assign(info, config.case_forms);
+        }
+        const uint64_t forms = config.case_forms.size();
+        const uint64_t suffixes = config.suffixes.size();
+        info_width_ = 2 + 4 * forms + suffixes * (4 + 4 * forms);
+        // Without target info only the base words themselves are generated
+        slots_ = infos_.empty() ? 1 : 1 + infos_.size() * info_width_ + suffixes * (1 + forms);
+        leet_width_ = 1;
+        rule_width_ = (transforms.rules != nullptr) ? transforms.rules->size() : 1;
+
+        uint64_t total = 0;
+        overflow_ = (transforms.leet != nullptr &&
+                     __builtin_add_overflow(static_cast<uint64_t>(transforms.leet_max_variants), 1, &leet_width_)) ||
+                    __builtin_mul_overflow(static_cast<uint64_t>(bases_.size()), slots_, &total) ||
+                    __builtin_mul_overflow(total, leet_width_, &total) ||
+                    __builtin_mul_overflow(total, rule_width_, &total);
+        size_ = overflow_ ? 0 : total;
+    }
+
+    /** @return The number of keyspace positions (0 if it does not fit in 64 bits). */
+    uint64_t size() const { return size_; }
+    /** @return true if the keyspace exceeds 2^64 - 1 positions. */
+    bool overflow() const { return overflow_; }
+    /** @return Keyspace positions per base word (W * L * R). */
+    uint64_t positions_per_base() const { return slots_ * leet_width_ * rule_width_; }
+
+    /** @return The usable base words, in keyspace order. */
+    const std::vector<StringView>& bases() const { return bases_; }
+    /** @return W: combination slots per base word. */
+    uint64_t slots() const { return slots_; }
+    /** @return L: leetspeak slots per combination (1 = original only). */
+    uint64_t leet_width() const { return leet_width_; }
+    /** @return R: rule slots per leetspeak variant. */
+    uint64_t rule_width() const { return rule_width_; }
+
+    /**
+     * @brief Classifies a combination slot (the same layout decode_combination() walks).
+     * @param slot Slot in [0, slots()).
+     */
+    SlotShape describe_slot(uint64_t slot) const {
+        static const Pattern k_plain_suffix_patterns[4] = {
+            PATTERN_BASE_INFO_SUFFIX, PATTERN_INFO_BASE_SUFFIX, PATTERN_BASE_SUFFIX_INFO, PATTERN_INFO_SUFFIX_BASE};
+        const uint64_t forms = config_.case_forms.size();
+        SlotShape shape;
+        if (slot == 0) return shape; // The base word itself
+        slot -= 1;
+
+        const uint64_t info_slots = infos_.size() * info_width_;
+        if (slot >= info_slots) { // Base word + suffix block
+            slot -= info_slots;
+            shape.pattern = PATTERN_BASE_SUFFIX;
+            shape.suffix = static_cast<size_t>(slot / (1 + forms));
+            if (slot % (1 + forms) != 0) shape.form = static_cast<size_t>(slot % (1 + forms) - 1);
+            return shape;
+        }
+
+        shape.info = static_cast<size_t>(slot / info_width_);
+        uint64_t q = slot % info_width_;
+        if (q < 2) {
+            shape.pattern = q == 0 ? PATTERN_BASE_INFO : PATTERN_INFO_BASE;
+            return shape;
+        }
+        q -= 2;
+        if (q >= 4 * forms) { // Suffix block: 4 plain patterns + 4 per form
+            q -= 4 * forms;
+            shape.suffix = static_cast<size_t>(q / (4 + 4 * forms));
+            q %= 4 + 4 * forms;
+            if (q < 4) {
+                shape.pattern = k_plain_suffix_patterns[q];
+                return shape;
+            }
+            q -= 4;
+        }
+        // Case-form pattern: q / 4 = form; q % 4 = xb xi, xi xb, xb i, i xb
+        const bool base_first = q % 4 == 0 || q % 4 == 2;
+        if (shape.suffix == SlotShape::k_none) {
+            shape.pattern = base_first ? PATTERN_BASE_INFO : PATTERN_INFO_BASE;
+        } else {
+            shape.pattern = base_first ? PATTERN_BASE_INFO_SUFFIX : PATTERN_INFO_BASE_SUFFIX;
+        }
+        shape.form = static_cast<size_t>(q / 4);
+        return shape;
+    }
+
+    /**
+     * @brief Fingerprints everything that determines the candidate at each position.
+     * Covers the base words, target info, suffixes, case forms, leetspeak table
+     * and variant cap, and the rules, so a checkpoint is only resumed against the
+     * keyspace it was taken from.
+     * @return A 64-bit digest.
+     */
+    uint64_t digest() const {
+        uint64_t h = size_;
+        auto fold = [&h](const char* data, size_t size) {
+            h = (h ^ hash_bytes(data, size)) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 29;
+        };
+        for (StringView word : bases_) fold(word.data(), word.size());
+        for (const WordVariants& info : infos_) fold(info.original.data(), info.original.size());
+        for (const std::string& suffix : config_.suffixes) fold(suffix.data(), suffix.size());
+        for (CaseForm form : config_.case_forms) fold(reinterpret_cast<const char*>(&form), sizeof(form));
+        const uint64_t transforms[3] = {
+            transforms_.leet != nullptr ? transforms_.leet->digest() : 0, leet_width_,
+            transforms_.rules != nullptr ? transforms_.rules->digest() : 0};
+        fold(reinterpret_cast<const char*>(transforms), sizeof(transforms));
+        return h;
+    }
+
+private:
+    friend class KeyspaceCursor;
+
+    const CombinatorConfig& config_;
+    const TransformConfig& transforms_;
+    std::vector<StringView> bases_;   // Printable, non-empty base words
+    std::vector<WordVariants> infos_; // Case variants of the usable target info
+    uint64_t info_width_;             // Slots per target info entry
+    uint64_t slots_;                  // W: combination slots per base word
+    uint64_t leet_width_;             // L: original + leetspeak variants
+    uint64_t rule_width_;             // R: rules (1 without a rule file)
+    uint64_t size_;                   // Total positions
+    bool overflow_;                   // size_ did not fit in 64 bits
+};
+
+/**
+ * @brief Decodes keyspace indices into candidates.
+ * Each lookup is O(1) in the size of the keyspace (O(length) work on the
+ * candidate itself). The cursor caches the current base word's case variants,
+ * combination and leetspeak variant, so walking consecutive indices only
+ * redoes the innermost stage that changed. One cursor per thread.
+ */
+class KeyspaceCursor {
+public:
+    explicit KeyspaceCursor(const Keyspace& keyspace)
+        : ks_(keyspace), cached_base_(~0ULL), cached_combo_(~0ULL), cached_leet_(~0ULL),
+          combo_valid_(false), leet_valid_(false) {}
+
+    /**
+     * @brief Computes the candidate at a keyspace position.
+     * @param index Position in [0, keyspace.size()).
+     * @param out Receives the candidate, valid until the next call.
+     * @return false if the position is a hole (nothing is emitted there).
+     */
+    bool at(uint64_t index, StringView& out) {
+        const uint64_t rule = index % ks_.rule_width_;
+        const uint64_t leet_index = index / ks_.rule_width_; // (base * W + slot) * L + leet
+        const uint64_t combo = leet_index / ks_.leet_width_; // base * W + slot
+
+        if (combo != cached_combo_) {
+            cached_combo_ = combo;
+            cached_leet_ = ~0ULL;
+            combo_valid_ = decode_combination(combo);
+        }
+        if (!combo_valid_) return false;
+
+        if (leet_index != cached_leet_) {
+            cached_leet_ = leet_index;
+            leet_valid_ = decode_leet(leet_index % ks_.leet_width_);
+        }
+        if (!leet_valid_) return false;
+
+        if (ks_.transforms_.rules == nullptr) {
+            out = leet_.view();
+        } else {
+            const int len = ks_.transforms_.rules->apply(static_cast<size_t>(rule), leet_.data(), leet_.size(),
+                                                         rule_output_);
+            if (len <= 0) return false;
+            out = StringView(rule_output_, static_cast<size_t>(len));
+        }
+        // Excluded candidates are holes: the position still counts
+        const XorFilter* exclude = ks_.transforms_.exclude;
+        return exclude == nullptr || !exclude->contains(hash_bytes(out.data(), out.size()));
+    }
+
+    /**
+     * @brief Calls f(candidate) for every non-hole position in [first, last).
+     * @return The number of candidates reported.
+     */
+    template <typename F>
+    uint64_t for_each(uint64_t first, uint64_t last, F f) {
+        const uint64_t k_publish_interval = 4096; // Positions between counter updates
+        ThreadStats& stats = Stats::local();
+        StringView candidate;
+        uint64_t count = 0;
+        uint64_t published = 0; // Candidates already added to stats
+        for (uint64_t index = first; index < last; ++index) {
+            if (at(index, candidate)) {
+                f(candidate);
+                ++count;
+            }
+            if ((index - first + 1) % k_publish_interval == 0) {
+                ThreadStats::add(stats.progress, k_publish_interval);
+                ThreadStats::add(stats.stages[STAT_COMBINE].produced, count - published);
+                published = count;
+            }
+        }
+        ThreadStats::add(stats.progress, (last - first) % k_publish_interval);
+        ThreadStats::add(stats.stages[STAT_COMBINE].produced, count - published);
+        return count;
+    }
+
+private:
+    /** @brief Builds combination_ for base * W + slot; false for a hole. */
+    bool decode_combination(uint64_t combo) {
+        const uint64_t base_index = combo / ks_.slots_;
+        uint64_t slot = combo % ks_.slots_;
+        if (base_index != cached_base_) {
+            cached_base_ = base_index;
+            base_.assign(ks_.bases_[base_index], ks_.config_.case_forms);
+        }
+        const std::string& b = base_.original;
+        const uint64_t forms = ks_.config_.case_forms.size();
+        const std::vector<std::string>& suffixes = ks_.config_.suffixes;
+
+        if (slot == 0) return combination_.assign(b); // The base word itself
+        slot -= 1;
+
+        const uint64_t info_slots = ks_.infos_.size() * ks_.info_width_;
+        if (slot >= info_slots) { // Base word + suffix block
+            slot -= info_slots;
+            const std::string& suffix = suffixes[slot / (1 + forms)];
+            const uint64_t form = slot % (1 + forms);
+            if (form == 0) return combination_.assign(b, suffix);
+            const size_t k = static_cast<size_t>(form - 1);
+            if (base_.same[k] || base_.first_equal[k] < k) return false;
+            return combination_.assign(base_.forms[k], suffix);
+        }
+
+        const WordVariants& info = ks_.infos_[slot / ks_.info_width_];
+        const std::string& i = info.original;
+        uint64_t q = slot % ks_.info_width_;
+        if (q < 2) return q == 0 ? combination_.assign(b, i) : combination_.assign(i, b); // b i, i b
+        q -= 2;
+        const std::string* suffix = nullptr;
+        if (q >= 4 * forms) { // Suffix block: 4 plain patterns + 4 per form
+            q -= 4 * forms;
+            suffix = &suffixes[q / (4 + 4 * forms)];
+            q %= 4 + 4 * forms;
+            if (q < 4) {
+                switch (q) {
+                case 0: return combination_.assign(b, i, *suffix);
+                case 1: return combination_.assign(i, b, *suffix);
+                case 2: return combination_.assign(b, *suffix, i);
+                default: return combination_.assign(i, *suffix, b);
+                }
+            }
+            q -= 4;
+        }
+        // Case-form pattern q / 4 = form, q % 4 = pattern (same skip rules as the generator)
+        const size_t k = static_cast<size_t>(q / 4);
+        if (base_.first_equal[k] < k && base_.first_equal[k] == info.first_equal[k]) return false;
+        const std::string& xb = base_.forms[k];
+        const std::string& xi = info.forms[k];
+        bool fits = false;
+        switch (q % 4) {
+        case 0: if (info.same[k]) return false; fits = combination_.assign(xb, xi); break;
+        case 1: if (info.same[k]) return false; fits = combination_.assign(xi, xb); break;
+        case 2: if (base_.same[k]) return false; fits = combination_.assign(xb, i); break;
+        default: if (base_.same[k]) return false; fits = combination_.assign(i, xb); break;
+        }
+        return fits && (suffix == nullptr || combination_.append(*suffix));
+    }
+
+    /** @brief Builds leet_ for leetspeak slot v of the current combination; false for a hole. */
+    bool decode_leet(uint64_t v) {
+        leet_.assign(combination_.view());
+        if (v == 0) return true;
+        const LeetTable& table = *ks_.transforms_.leet;
+        if (ks_.transforms_.leet_max_variants == 1) {
+            return table.translate(leet_.data(), leet_.data(), leet_.size());
+        }
+        return table.variant_at(leet_.data(), leet_.size(), static_cast<size_t>(v));
+    }
+
+    const Keyspace& ks_;
+    WordVariants base_;           // Case variants of the cached base word
+    CandidateBuffer combination_; // Cached combination (before transforms)
+    CandidateBuffer leet_;        // Cached leetspeak variant of combination_
+    char rule_output_[RuleSet::k_buffer_size]; // Output of the current rule
+    uint64_t cached_base_;    // Base index of base_
+    uint64_t cached_combo_;   // base * W + slot of combination_
+    uint64_t cached_leet_;    // (base * W + slot) * L + leet of leet_
+    bool combo_valid_;        // combination_ is not a hole
+    bool leet_valid_;         // leet_ is not a hole
+};
+
+// --- Probability Ordering ---
+
+/**
+ * @brief Log-probability model for probability-ordered output.
+ * A candidate's score is a sum of independent terms, one per keyspace
+ * dimension: its base word, its combination slot (pattern, case form, suffix
+ * and target info entry), its leetspeak slot and its rule. Weights are
+ * relative probabilities on any positive scale. Lists that carry no weights of
+ * their own (base words, target info, rules, leetspeak variants) get a
+ * Zipf-like prior from their order, -exponent * ln(rank + 1), since wordlists
+ * and rule files are conventionally sorted most effective first.
+ */
+class ScoreModel {
+public:
+    ScoreModel()
+        : case_original_(1.0), suffix_default_(1.0), leet_none_(1.0), leet_variant_(0.1),
+          base_rank_(1.0), info_rank_(0.5), leet_rank_(1.0), rule_rank_(1.0), trained_bases_(false) {
+        const double patterns[PATTERN_COUNT] = {1.0, 0.3, 0.3, 0.2, 0.2, 0.02, 0.02, 0.6};
+        std::copy(patterns, patterns + PATTERN_COUNT, pattern_);
+        case_[CASE_LOWER] = 0.6;
+        case_[CASE_CAPITALIZED] = 0.5;
+        case_[CASE_UPPER] = 0.05;
+        case_[CASE_TOGGLED] = 0.01;
+    }
+
+    /**
+     * @brief Reads weights from a file of "key value" lines, keeping the
+     * current value of every key the file does not mention.
+     * Keys: pattern.<name> (see k_pattern_names), case.original, case.lower,
+     * case.cap, case.upper, case.toggle, suffix.<text>, suffix.default,
+     * leet.none, leet.variant, and the rank exponents rank.base, rank.info,
+     * rank.leet and rank.rule. Blank lines and lines starting with '#' are ignored.
+     * @return false if the file could not be read.
+     */
+    bool load(const std::string& path) {
+        Wordlist lines;
+        if (!lines.load(path)) return false;
+        for (StringView line : lines) {
+            if (line[0] == '#') continue;
+            const std::string text = line.str();
+            const size_t space = text.find_first_of(" \t");
+            char* end = nullptr;
+            const double value = space == std::string::npos ? 0 : std::strtod(text.c_str() + space + 1, &end);
+            const std::string key = text.substr(0, space);
+            if (space == std::string::npos || end == text.c_str() + space + 1 || *end != '\0' || !set(key, value)) {
+                std::cerr << "Warning: Ignoring weights line \"" << text << "\" (expected \"key value\")." << std::endl;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Writes every weight in the format load() reads (the base word
+     * counts of train() are not included).
+     * @return false if the file could not be written.
+     */
+    bool save(const std::string& path, const std::vector<std::string>& suffixes) const {
+        std::ofstream out(path.c_str());
+        out.precision(6);
+        out << "# Candidate scoring weights (relative probabilities)\n";
+        for (int p = 0; p < PATTERN_COUNT; ++p) out << "pattern." << k_pattern_names[p] << ' ' << pattern_[p] << '\n';
+        out << "case.original " << case_original_ << '\n' << "case.lower " << case_[CASE_LOWER] << '\n'
+            << "case.cap " << case_[CASE_CAPITALIZED] << '\n' << "case.upper " << case_[CASE_UPPER] << '\n'
+            << "case.toggle " << case_[CASE_TOGGLED] << '\n';
+        out << "suffix.default " << suffix_default_ << '\n';
+        for (const std::string& suffix : suffixes) out << "suffix." << suffix << ' ' << suffix_weight(suffix) << '\n';
+        out << "leet.none " << leet_none_ << '\n' << "leet.variant " << leet_variant_ << '\n';
+        out << "rank.base " << base_rank_ << '\n' << "rank.info " << info_rank_ << '\n'
+            << "rank.leet " << leet_rank_ << '\n' << "rank.rule " << rule_rank_ << '\n';
+        out.close();
+        return !out.fail();
+    }
+
+    /**
+     * @brief Learns the weights a plain password list can tell apart.
+     * Every line is split into its leading letters and the rest. From that it
+     * estimates how often a password is a bare word (pattern.base) or a word
+     * plus a non-letter tail (pattern.base_suffix), which of the configured
+     * suffixes the tails are, how the words are cased, and how often a
+     * leetspeak character stands between letters. Every run of letters that
+     * equals a base word (case-insensitively) counts as a use of that word;
+     * the counts replace the rank prior of the base words. The patterns with
+     * target info cannot be observed in a public list; they keep their weight
+     * relative to pattern.base.
+     * @return false if the file could not be read or had no usable line.
+     */
+    bool train(const std::string& path, const std::vector<StringView>& base_words,
+               const std::vector<std::string>& suffixes, const LeetTable& leet) {
+        Wordlist lines;
+        if (!lines.load(path)) return false;
+
+        base_counts_.clear();
+        std::string lower;
+        for (StringView word : base_words) base_counts_[lowercase_hash(word, lower)] = 0;
+        bool substitute[256] = {};
+        for (int c = 0; c < 256; ++c) {
+            char in = static_cast<char>(c), out = 0;
+            if (leet.translate(&in, &out, 1)) substitute[static_cast<uint8_t>(out)] = true;
+        }
+
+        uint64_t total = 0, bare = 0, tailed = 0, leeted = 0, cased[4] = {}, uncased = 0;
+        std::vector<uint64_t> suffix_counts(suffixes.size(), 0);
+        auto is_letter = [](char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; };
+        auto is_upper = [](char c) { return std::isupper(static_cast<unsigned char>(c)) != 0; };
+        auto is_lower = [](char c) { return std::islower(static_cast<unsigned char>(c)) != 0; };
+        for (StringView line : lines) {
+            if (!is_printable(line)) continue;
+            ++total;
+            size_t letters = 0;
+            while (letters < line.size() && is_letter(line[letters])) ++letters;
+            bool tail_has_letters = false;
+            for (size_t i = letters; i < line.size(); ++i) tail_has_letters |= is_letter(line[i]);
+            if (letters > 0 && letters == line.size()) {
+                ++bare;
+            } else if (letters > 0 && !tail_has_letters) {
+                ++tailed;
+                const StringView tail(line.data() + letters, line.size() - letters);
+                for (size_t s = 0; s < suffixes.size(); ++s) {
+                    if (tail.size() == suffixes[s].size() &&
+                        std::memcmp(tail.data(), suffixes[s].data(), tail.size()) == 0) ++suffix_counts[s];
+                }
+            }
+            if (letters >= 2) {
+                const char* word = line.data();
+                int form = -1;
+                if (std::none_of(word, word + letters, is_upper)) form = CASE_LOWER;
+                else if (std::none_of(word, word + letters, is_lower)) form = CASE_UPPER;
+                else if (is_upper(word[0]) && std::none_of(word + 1, word + letters, is_upper)) form = CASE_CAPITALIZED;
+                else if (is_lower(word[0]) && std::none_of(word + 1, word + letters, is_lower)) form = CASE_TOGGLED;
+                if (form >= 0) ++cased[form];
+                else ++uncased;
+            }
+            for (size_t i = 1; i + 1 < line.size(); ++i) {
+                if (substitute[static_cast<uint8_t>(line[i])] && is_letter(line[i - 1]) && is_letter(line[i + 1])) {
+                    ++leeted;
+                    break;
+                }
+            }
+            // Letter runs that are base words
+            for (size_t i = 0; i < line.size();) {
+                if (!is_letter(line[i])) {
+                    ++i;
+                    continue;
+                }
+                size_t j = i;
+                while (j < line.size() && is_letter(line[j])) ++j;
+                std::unordered_map<uint64_t, uint32_t>::iterator it =
+                    base_counts_.find(lowercase_hash(StringView(line.data() + i, j - i), lower));
+                if (it != base_counts_.end()) ++it->second;
+                i = j;
+            }
+        }
+        if (total == 0) return false;
+
+        // Smoothed frequencies: nothing observed zero times gets probability 0
+        auto frequency = [](uint64_t count, uint64_t out_of) { return (count + 0.5) / (out_of + 1.0); };
+        const double scale = frequency(bare, total) / pattern_[PATTERN_BASE];
+        for (int p = PATTERN_BASE_INFO; p <= PATTERN_INFO_SUFFIX_BASE; ++p) pattern_[p] *= scale;
+        pattern_[PATTERN_BASE] = frequency(bare, total);
+        pattern_[PATTERN_BASE_SUFFIX] = frequency(tailed, total);
+        suffix_.clear();
+        suffix_default_ = frequency(0, tailed);
+        for (size_t s = 0; s < suffixes.size(); ++s) suffix_[suffixes[s]] = frequency(suffix_counts[s], tailed);
+        const uint64_t words = cased[0] + cased[1] + cased[2] + cased[3] + uncased;
+        for (int form = 0; form < 4; ++form) case_[form] = frequency(cased[form], words);
+        case_original_ = case_[CASE_LOWER]; // Wordlists are mostly lowercase
+        leet_variant_ = frequency(leeted, total);
+        leet_none_ = 1.0 - leet_variant_;
+        trained_bases_ = true;
+        return true;
+    }
+
+    /** @return true once train() has supplied base word counts. */
+    bool trained() const { return trained_bases_; }
+
+    /** @brief Score of base word rank (its position in the list). */
+    double base_score(size_t rank, StringView word) const {
+        if (trained_bases_) {
+            std::string lower;
+            std::unordered_map<uint64_t, uint32_t>::const_iterator it = base_counts_.find(lowercase_hash(word, lower));
+            return std::log((it == base_counts_.end() ? 0 : it->second) + 0.5);
+        }
+        return -base_rank_ * std::log(rank + 1.0);
+    }
+
+    /** @brief Score of a combination slot. */
+    double slot_score(const SlotShape& shape, const CombinatorConfig& config) const {
+        double score = std::log(pattern_[shape.pattern]);
+        score += std::log(shape.form == SlotShape::k_none ? case_original_ : case_[config.case_forms[shape.form]]);
+        if (shape.suffix != SlotShape::k_none) score += std::log(suffix_weight(config.suffixes[shape.suffix]));
+        if (shape.info != SlotShape::k_none) score -= info_rank_ * std::log(shape.info + 1.0);
+        return score;
+    }
+
+    /** @brief Score of leetspeak slot v (0 = unchanged, then the variants in enumeration order). */
+    double leet_score(uint64_t v) const {
+        if (v == 0) return std::log(leet_none_);
+        return std::log(leet_variant_) - leet_rank_ * std::log(static_cast<double>(v));
+    }
+
+    /** @brief Score of rule r (its position in the rule file). */
+    double rule_score(uint64_t r) const { return -rule_rank_ * std::log(r + 1.0); }
+
+private:
+    /** @brief Sets one weight; false for an unknown key or an out-of-range value. */
+    bool set(const std::string& key, double value) {
+        const bool rank = key.compare(0, 5, "rank.") == 0;
+        if (rank ? !(value >= 0) : !(value > 0)) return false;
+        for (int p = 0; p < PATTERN_COUNT; ++p) {
+            if (key == std::string("pattern.") + k_pattern_names[p]) {
+                pattern_[p] = value;
+                return true;
+            }
+        }
+        if (key == "case.original") case_original_ = value;
+        else if (key == "case.lower") case_[CASE_LOWER] = value;
+        else if (key == "case.cap") case_[CASE_CAPITALIZED] = value;
+        else if (key == "case.upper") case_[CASE_UPPER] = value;
+        else if (key == "case.toggle") case_[CASE_TOGGLED] = value;
+        else if (key == "suffix.default") suffix_default_ = value;
+        else if (key.compare(0, 7, "suffix.") == 0 && key.size() > 7) suffix_[key.substr(7)] = value;
+        else if (key == "leet.none") leet_none_ = value;
+        else if (key == "leet.variant") leet_variant_ = value;
+        else if (key == "rank.base") base_rank_ = value;
+        else if (key == "rank.info") info_rank_ = value;
+        else if (key == "rank.leet") leet_rank_ = value;
+        else if (key == "rank.rule") rule_rank_ = value;
+        else return false;
+        return true;
+    }
+
+    double suffix_weight(const std::string& suffix) const {
+        std::map<std::string, double>::const_iterator it = suffix_.find(suffix);
+        return it == suffix_.end() ? suffix_default_ : it->second;
+    }
+
+    static uint64_t lowercase_hash(StringView word, std::string& scratch) {
+        scratch.assign(word.data(), word.size());
+        for (char& c : scratch) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return hash_bytes(scratch.data(), scratch.size());
+    }
+
+    double pattern_[PATTERN_COUNT];       // Weight of each combination pattern
+    double case_original_;                // Weight of the unchanged spelling
+    double case_[4];                      // Weight of each CaseForm
+    std::map<std::string, double> suffix_; // Weight of each suffix ...
+    double suffix_default_;               // ... and of suffixes not listed
+    double leet_none_;                    // Weight of leaving a candidate as it is
+    double leet_variant_;                 // Weight of its first leetspeak variant
+    double base_rank_, info_rank_, leet_rank_, rule_rank_; // Zipf exponents of list order
+    std::unordered_map<uint64_t, uint32_t> base_counts_;   // Lowercase base word hash -> uses in training
+    bool trained_bases_;                  // base_counts_ replaces the base rank prior
+};
+
+/**
+ * @brief Enumerates keyspace positions in descending score order.
+ * The score is a sum of one term per dimension (base word, slot, leetspeak,
+ * rule), so each dimension is sorted by its own term once and the positions
+ * are walked best-first over the product of the four sorted lists with a
+ * priority queue: a tuple of ranks is pushed only when its parent (the tuple
+ * with its last non-zero rank decremented, which never scores lower) is
+ * popped. Every position is produced exactly once, nothing is sorted beyond
+ * the dimensions themselves, and memory grows with the frontier, not with the
+ * keyspace. Ties go to the earlier keyspace position.
+ */
+class ProbabilityOrder {
+public:
+    /** Most entries a dimension may have: each is sorted in memory, with 32-bit indices. */
+    static const uint64_t k_max_dimension = 1 << 25;
+
+    /**
+     * @return The name of the first dimension of keyspace with more than
+     *         k_max_dimension entries, or nullptr if the keyspace can be ordered.
+     */
+    static const char* oversized_dimension(const Keyspace& keyspace) {
+        if (keyspace.bases().size() > k_max_dimension) return "base words";
+        if (keyspace.slots() > k_max_dimension) return "combination slots (target info x suffixes x case forms)";
+        if (keyspace.leet_width() > k_max_dimension) return "leetspeak variants (--leet-max)";
+        if (keyspace.rule_width() > k_max_dimension) return "rules";
+        return nullptr;
+    }
+
+    /** @param keyspace A keyspace without oversized_dimension(). */
+    ProbabilityOrder(const Keyspace& keyspace, const ScoreModel& model, const CombinatorConfig& config)
+        : slots_(keyspace.slots()), leet_width_(keyspace.leet_width()), rule_width_(keyspace.rule_width()) {
+        const std::vector<StringView>& bases = keyspace.bases();
+        build(dimensions_[0], bases.size(), [&](size_t i) { return model.base_score(i, bases[i]); });
+        build(dimensions_[1], slots_, [&](size_t i) { return model.slot_score(keyspace.describe_slot(i), config); });
+        build(dimensions_[2], leet_width_, [&](size_t i) { return model.leet_score(i); });
+        build(dimensions_[3], rule_width_, [&](size_t i) { return model.rule_score(i); });
+        if (bases.empty()) return;
+        Node root;
+        std::fill(root.rank, root.rank + k_dimensions, 0);
+        root.last = 0;
+        finish(root);
+        heap_.push(root);
+    }
+
+    /**
+     * @brief Produces the next position.
+     * @param position Receives the keyspace position.
+     * @param score Receives its score (natural log of the relative probability).
+     * @return false once every position has been produced.
+     */
+    bool next(uint64_t& position, double& score) {
+        if (heap_.empty()) return false;
+        const Node node = heap_.top();
+        heap_.pop();
+        for (unsigned d = node.last; d < k_dimensions; ++d) {
+            if (node.rank[d] + 1 >= dimensions_[d].order.size()) continue;
+            Node child = node;
+            ++child.rank[d];
+            child.last = static_cast<uint8_t>(d);
+            finish(child);
+            heap_.push(child);
+        }
+        position = node.position;
+        score = node.score;
+        return true;
+    }
+
+    /** @return Positions waiting in the priority queue (the frontier). */
+    size_t frontier() const { return heap_.size(); }
+
+private:
+    static const unsigned k_dimensions = 4;
+
+    struct Dimension {
+        std::vector<uint32_t> order; // Indices, best score first
+        std::vector<double> score;   // score[r] = score of order[r]
+    };
+
+    struct Node {
+        double score;
+        uint64_t position;
+        uint32_t rank[k_dimensions]; // Rank in each dimension's order
+        uint8_t last;                // Dimension of the last increment (children only go from here on)
+
+        bool operator<(const Node& other) const {
+            return score < other.score || (score == other.score && position > other.position);
+        }
+    };
+
+    template <typename F>
+    static void build(Dimension& dimension, uint64_t size, F score_of) {
+        std::vector<double> scores(static_cast<size_t>(size));
+        dimension.order.resize(static_cast<size_t>(size));
+        for (size_t i = 0; i < scores.size(); ++i) {
+            scores[i] = score_of(i);
+            dimension.order[i] = static_cast<uint32_t>(i);
+        }
+        std::stable_sort(dimension.order.begin(), dimension.order.end(),
+                         [&](uint32_t a, uint32_t b) { return scores[a] > scores[b]; });
+        dimension.score.resize(scores.size());
+        for (size_t r = 0; r < scores.size(); ++r) dimension.score[r] = scores[dimension.order[r]];
+    }
+
+    /** @brief Fills in the score and keyspace position of a tuple of ranks. */
+    void finish(Node& node) const {
+        const Dimension* d = dimensions_;
+        node.score = d[0].score[node.rank[0]] + d[1].score[node.rank[1]] +
+                     d[2].score[node.rank[2]] + d[3].score[node.rank[3]];
+        node.position = ((static_cast<uint64_t>(d[0].order[node.rank[0]]) * slots_ + d[1].order[node.rank[1]]) *
+                         leet_width_ + d[2].order[node.rank[2]]) * rule_width_ + d[3].order[node.rank[3]];
+    }
+
+    Dimension dimensions_[k_dimensions]; // Base words, slots, leetspeak slots, rules
+    uint64_t slots_;                     // W
+    uint64_t leet_width_;                // L
+    uint64_t rule_width_;                // R
+    std::priority_queue<Node> heap_;     // Frontier, best first
+};
+
+// --- PCFG Generation ---
+
+/**
+ * @brief Probabilistic context-free grammar of passwords (Weir et al.).
+ * Every training password is split into runs of one character class, letters
+ * (L), digits (D) and symbols (S), which gives its structure: "Summer2024!"
+ * is L6 D4 S1. The grammar counts the structures and, per class and run
+ * length, the terminals the runs produced: digit and symbol runs keep their
+ * text, letter runs only their capitalization mask ("ULLLLL"), since the
+ * letters themselves come from the base words and target info at generation
+ * time (see PcfgGuesser). Probabilities are relative frequencies within the
+ * structures and within each (class, length) group.
+ *
+ * save() writes a compact binary file that load() reads in one pass: counts
+ * are stored most frequent first and the fixed-length terminals of a group
+ * back to back, so loading is a handful of copies and no parsing.
+ */
+class PcfgGrammar {
+public:
+    enum SymbolClass { CLASS_LETTER, CLASS_DIGIT, CLASS_SYMBOL, CLASS_COUNT };
+    static const size_t k_max_segments = 16; // Structures with more runs are too rare to learn from
+    static const char k_magic[8];            // First bytes of a grammar file (format version included)
+
+    /** @brief One run of a structure. */
+    struct Segment {
+        uint8_t symbol_class; // SymbolClass
+        uint8_t length;       // Characters in the run
+    };
+
+    /** @brief A structure and how often it was seen. */
+    struct Structure {
+        std::vector<Segment> segments;
+        uint32_t count;
+    };
+
+    /** @brief The terminals of one class and run length, most frequent first. */
+    struct Group {
+        uint8_t symbol_class = 0;
+        uint8_t length = 0;
+        std::vector<uint32_t> counts; // counts[i] = occurrences of terminal i
+        std::string terminals;        // Terminal i occupies [i * length, (i + 1) * length)
+        uint64_t total = 0;           // Sum of counts
+
+        size_t size() const { return counts.size(); }
+        StringView terminal(size_t i) const { return StringView(terminals.data() + i * length, length); }
+        /** @brief Natural log probability of terminal i. */
+        double score(size_t i) const { return std::log(static_cast<double>(counts[i]) / total); }
+    };
+
+    PcfgGrammar() : structure_total_(0) { std::fill(&group_index_[0][0], &group_index_[0][0] + CLASS_COUNT * 256, -1); }
+
+    /**
+     * @brief Learns the grammar from a password list, replacing the current one.
+     * Lines that are not printable ASCII, are longer than CandidateBuffer::k_capacity
+     * or have more than k_max_segments runs are skipped.
+     * @return false if the file could not be read or had no usable line.
+     */
+    bool train(const std::string& path) {
+        Wordlist lines;
+        if (!lines.load(path)) return false;
+        std::map<std::string, uint32_t> structure_counts;         // Segment bytes -> count
+        std::map<uint16_t, std::unordered_map<std::string, uint32_t>> terminal_counts; // (class, length) -> terminal -> count
+        std::string shape;
+        std::string terminal;
+        for (StringView line : lines) {
+            if (line.size() > CandidateBuffer::k_capacity || !is_printable(line)) continue;
+            shape.clear();
+            for (size_t i = 0; i < line.size() && shape.size() <= 2 * k_max_segments;) {
+                const uint8_t symbol_class = classify(line[i]);
+                size_t j = i + 1;
+                while (j < line.size() && classify(line[j]) == symbol_class) ++j;
+                if (j - i > 255) break;
+                shape.push_back(static_cast<char>(symbol_class));
+                shape.push_back(static_cast<char>(j - i));
+                i = j;
+            }
+            size_t covered = 0;
+            for (size_t s = 1; s < shape.size(); s += 2) covered += static_cast<uint8_t>(shape[s]);
+            if (covered != line.size() || shape.size() > 2 * k_max_segments) continue;
+            ++structure_counts[shape];
+            for (size_t s = 0, i = 0; s < shape.size(); s += 2) {
+                const uint8_t symbol_class = static_cast<uint8_t>(shape[s]);
+                const uint8_t length = static_cast<uint8_t>(shape[s + 1]);
+                if (symbol_class == CLASS_LETTER) {
+                    terminal.assign(length, 'L');
+                    for (size_t k = 0; k < length; ++k) {
+                        if (std::isupper(static_cast<unsigned char>(line[i + k]))) terminal[k] = 'U';
+                    }
+                } else {
+                    terminal.assign(line.data() + i, length);
+                }
+                ++terminal_counts[group_key(symbol_class, length)][terminal];
+                i += length;
+            }
+        }
+        if (structure_counts.empty()) return false;
+
+        structures_.clear();
+        structure_total_ = 0;
+        for (const auto& entry : structure_counts) {
+            Structure structure;
+            for (size_t s = 0; s < entry.first.size(); s += 2) {
+                Segment segment = {static_cast<uint8_t>(entry.first[s]), static_cast<uint8_t>(entry.first[s + 1])};
+                structure.segments.push_back(segment);
+            }
+            structure.count = entry.second;
+            structure_total_ += entry.second;
+            structures_.push_back(structure);
+        }
+        std::stable_sort(structures_.begin(), structures_.end(),
+                         [](const Structure& a, const Structure& b) { return a.count > b.count; });
+        groups_.clear();
+        std::vector<std::pair<std::string, uint32_t>> sorted;
+        for (const auto& entry : terminal_counts) {
+            sorted.assign(entry.second.begin(), entry.second.end());
+            std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, uint32_t>& a,
+                                                       const std::pair<std::string, uint32_t>& b) {
+                return a.second > b.second || (a.second == b.second && a.first < b.first);
+            });
+            Group group;
+            group.symbol_class = static_cast<uint8_t>(entry.first >> 8);
+            group.length = static_cast<uint8_t>(entry.first);
+            for (const auto& terminal_count : sorted) {
+                group.counts.push_back(terminal_count.second);
+                group.terminals += terminal_count.first;
+                group.total += terminal_count.second;
+            }
+            groups_.push_back(std::move(group));
+        }
+        index_groups();
+        return true;
+    }
+
+    /**
+     * @brief Writes the grammar in the binary format load() reads.
+     * Layout (integers little-endian): the 8-byte magic; u32 structure count,
+     * then per structure u32 count, u8 runs and (u8 class, u8 length) per run;
+     * u32 group count, then per group u8 class, u8 length, u32 terminals,
+     * their u32 counts and their text back to back.
+     * @return false if the file could not be written.
+     */
+    bool save(const std::string& path) const {
+        std::string out(k_magic, sizeof(k_magic));
+        put_u32(out, static_cast<uint32_t>(structures_.size()));
+        for (const Structure& structure : structures_) {
+            put_u32(out, structure.count);
+            out.push_back(static_cast<char>(structure.segments.size()));
+            for (const Segment& segment : structure.segments) {
+                out.push_back(static_cast<char>(segment.symbol_class));
+                out.push_back(static_cast<char>(segment.length));
+            }
+        }
+        put_u32(out, static_cast<uint32_t>(groups_.size()));
+        for (const Group& group : groups_) {
+            out.push_back(static_cast<char>(group.symbol_class));
+            out.push_back(static_cast<char>(group.length));
+            put_u32(out, static_cast<uint32_t>(group.size()));
+            for (uint32_t count : group.counts) put_u32(out, count);
+            out += group.terminals;
+        }
+        std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        file.close();
+        return !file.fail();
+    }
+
+    /**
+     * @brief Reads a grammar written by save(), replacing the current one.
+     * @return false if the file could not be read or is not a valid grammar.
+     */
+    bool load(const std::string& path) {
+        MappedFile file;
+        if (!file.open(path)) return false;
+        const char* p = file.data();
+        const char* const end = p + file.size();
+        // Consumes n bytes; nullptr if the file is too short
+        auto take = [&](size_t n) -> const char* {
+            if (static_cast<size_t>(end - p) < n) return nullptr;
+            const char* at = p;
+            p += n;
+            return at;
+        };
+        auto read_u32 = [&](uint32_t& value) -> bool {
+            const char* at = take(4);
+            if (at != nullptr) value = get_u32(at);
+            return at != nullptr;
+        };
+        const char* magic = take(sizeof(k_magic));
+        if (magic == nullptr || std::memcmp(magic, k_magic, sizeof(k_magic)) != 0) return false;
+
+        std::vector<Structure> structures;
+        uint64_t structure_total = 0;
+        uint32_t count = 0;
+        if (!read_u32(count)) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            Structure structure;
+            const char* runs = nullptr;
+            if (!read_u32(structure.count) || structure.count == 0 || (runs = take(1)) == nullptr) return false;
+            const uint8_t segments = static_cast<uint8_t>(*runs);
+            const char* bytes = take(2 * static_cast<size_t>(segments));
+            if (segments == 0 || segments > k_max_segments || bytes == nullptr) return false;
+            for (uint8_t s = 0; s < segments; ++s) {
+                Segment segment = {static_cast<uint8_t>(bytes[2 * s]), static_cast<uint8_t>(bytes[2 * s + 1])};
+                if (segment.symbol_class >= CLASS_COUNT || segment.length == 0) return false;
+                structure.segments.push_back(segment);
+            }
+            structure_total += structure.count;
+            structures.push_back(std::move(structure));
+        }
+        std::vector<Group> groups;
+        std::unordered_set<uint16_t> seen_keys;
+        if (!read_u32(count)) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            Group group;
+            const char* key = take(2);
+            uint32_t size = 0;
+            if (key == nullptr || !read_u32(size) || size == 0) return false;
+            group.symbol_class = static_cast<uint8_t>(key[0]);
+            group.length = static_cast<uint8_t>(key[1]);
+            if (group.symbol_class >= CLASS_COUNT || group.length == 0) return false;
+            // One group per (class, length): a second one would shadow the first in group()
+            if (!seen_keys.insert(group_key(group.symbol_class, group.length)).second) return false;
+            const char* counts = take(4 * static_cast<size_t>(size));
+            const char* terminals = take(static_cast<size_t>(size) * group.length);
+            if (counts == nullptr || terminals == nullptr) return false;
+            // Terminals are stored back to back, group.length bytes each, so a
+            // newline or a byte of another class means a terminal of the wrong length
+            for (size_t b = 0; b < static_cast<size_t>(size) * group.length; ++b) {
+                if (!matches_class(terminals[b], group.symbol_class)) return false;
+            }
+            group.counts.resize(size);
+            for (uint32_t t = 0; t < size; ++t) {
+                group.counts[t] = get_u32(counts + 4 * t);
+                // The guesser relies on the most frequent terminal coming first
+                if (group.counts[t] == 0 || (t > 0 && group.counts[t] > group.counts[t - 1])) return false;
+                group.total += group.counts[t];
+            }
+            group.terminals.assign(terminals, static_cast<size_t>(size) * group.length);
+            groups.push_back(std::move(group));
+        }
+        if (p != end || structures.empty()) return false;
+        structures_.swap(structures);
+        structure_total_ = structure_total;
+        groups_.swap(groups);
+        index_groups();
+        return true;
+    }
+
+    /** @return The structures, most frequent first. */
+    const std::vector<Structure>& structures() const { return structures_; }
+
+    /** @return The number of training passwords the structure counts add up to. */
+    uint64_t structure_total() const { return structure_total_; }
+
+    /** @return The terminals of a class and run length, or nullptr if none were seen. */
+    const Group* group(uint8_t symbol_class, uint8_t length) const {
+        const int32_t index = symbol_class < CLASS_COUNT ? group_index_[symbol_class][length] : -1;
+        return index < 0 ? nullptr : &groups_[static_cast<size_t>(index)];
+    }
+
+    /** @return The number of terminals over all groups. */
+    size_t terminal_count() const {
+        size_t terminals = 0;
+        for (const Group& group : groups_) terminals += group.size();
+        return terminals;
+    }
+
+    /** @return The class of a printable ASCII character. */
+    static uint8_t classify(char c) {
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (std::isalpha(u)) return CLASS_LETTER;
+        return std::isdigit(u) ? CLASS_DIGIT : CLASS_SYMBOL;
+    }
+
+private:
+    static uint16_t group_key(uint8_t symbol_class, uint8_t length) {
+        return static_cast<uint16_t>(symbol_class << 8 | length);
+    }
+
+    /** @return Whether a terminal byte belongs to a class: 'L' or 'U' for letter masks, else printable ASCII of the class. */
+    static bool matches_class(char c, uint8_t symbol_class) {
+        if (symbol_class == CLASS_LETTER) return c == 'L' || c == 'U';
+        return c >= 0x20 && c < 0x7f && classify(c) == symbol_class;
+    }
+
+    static void put_u32(std::string& out, uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) out.push_back(static_cast<char>(value >> shift));
+    }
+
+    static uint32_t get_u32(const char* p) {
+        const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<uint32_t>(u[0]) | static_cast<uint32_t>(u[1]) << 8 |
+               static_cast<uint32_t>(u[2]) << 16 | static_cast<uint32_t>(u[3]) << 24;
+    }
+
+    void index_groups() {
+        std::fill(&group_index_[0][0], &group_index_[0][0] + CLASS_COUNT * 256, -1);
+        for (size_t i = 0; i < groups_.size(); ++i) {
+            group_index_[groups_[i].symbol_class][groups_[i].length] = static_cast<int32_t>(i);
+        }
+    }
+
+    std::vector<Structure> structures_;      // Most frequent first
+    uint64_t structure_total_;               // Sum of the structure counts
+    std::vector<Group> groups_;              // Terminal groups
+    int32_t group_index_[CLASS_COUNT][256];  // (class, length) -> index into groups_ (-1 = none)
+};
+
+const char PcfgGrammar::k_magic[8] = {'C', 'G', 'P', 'C', 'F', 'G', '0', '1'};
+
+/**
+ * @brief Produces the guesses of a PcfgGrammar in descending probability order.
+ * A pre-terminal is a structure with a terminal chosen for every run: a digit
+ * or symbol string, or a capitalization mask. Its letter runs are filled with
+ * every base word and target info entry of the run's length (letters only,
+ * lowercased, then capitalized by the mask). All fillers of a length are
+ * equally likely, so the guesses of a pre-terminal share one probability,
+ *   P(structure) * product of P(terminal) / product of (fillers of the run's length),
+ * and come out in exact probability order as long as the pre-terminals do.
+ * Those are walked best-first with a priority queue as in ProbabilityOrder:
+ * a pre-terminal is pushed only by its parent, the one with its last non-zero
+ * rank decremented, so each is produced once and memory grows with the
+ * frontier. Every guess is distinct, because a string determines its
+ * structure, its terminals and its lowercase fillers.
+ */
+class PcfgGuesser {
+public:
+    PcfgGuesser(const PcfgGrammar& grammar, const std::vector<StringView>& base_words,
+                const std::vector<StringView>& target_info)
+        : expanding_(false) {
+        // Fillers by length: distinct lowercase letter-only words, base words first
+        fillers_.resize(256);
+        std::unordered_set<std::string> seen;
+        std::string lower;
+        for (const std::vector<StringView>* list : {&base_words, &target_info}) {
+            for (StringView word : *list) {
+                if (word.empty() || word.size() > 255) continue;
+                lower.assign(word.data(), word.size());
+                bool letters = true;
+                for (char& c : lower) {
+                    letters &= PcfgGrammar::classify(c) == PcfgGrammar::CLASS_LETTER;
+                    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                }
+                if (letters && seen.insert(lower).second) fillers_[lower.size()] += lower;
+            }
+        }
+
+        // A structure is usable when every run has terminals and every letter run fillers
+        const std::vector<PcfgGrammar::Structure>& structures = grammar.structures();
+        for (size_t i = 0; i < structures.size(); ++i) {
+            Plan plan;
+            plan.score = std::log(static_cast<double>(structures[i].count) / grammar.structure_total());
+            size_t length = 0;
+            bool usable = true;
+            for (const PcfgGrammar::Segment& segment : structures[i].segments) {
+                const PcfgGrammar::Group* group = grammar.group(segment.symbol_class, segment.length);
+                const size_t fillers = fillers_[segment.length].size() / segment.length;
+                if (group == nullptr || (segment.symbol_class == PcfgGrammar::CLASS_LETTER && fillers == 0)) {
+                    usable = false;
+                    break;
+                }
+                if (segment.symbol_class == PcfgGrammar::CLASS_LETTER) plan.score -= std::log(static_cast<double>(fillers));
+                plan.groups.push_back(group);
+                length += segment.length;
+            }
+            if (!usable || length > CandidateBuffer::k_capacity) continue;
+            Node root;
+            root.structure = static_cast<uint32_t>(plans_.size());
+            root.last = 0;
+            std::fill(root.rank, root.rank + PcfgGrammar::k_max_segments, 0);
+            root.score = plan.score;
+            for (const PcfgGrammar::Group* group : plan.groups) root.score += group->score(0);
+            plans_.push_back(std::move(plan));
+            heap_.push(root);
+        }
+    }
+
+    /**
+     * @brief Produces the next guess.
+     * @param guess Receives the guess (valid until the next call).
+     * @param score Receives its natural log probability.
+     * @return false once every guess has been produced.
+     */
+    bool next(StringView& guess, double& score) {
+        if (!expanding_) {
+            if (heap_.empty()) return false;
+            current_ = heap_.top();
+            heap_.pop();
+            const Plan& plan = plans_[current_.structure];
+            for (size_t d = current_.last; d < plan.groups.size(); ++d) {
+                const PcfgGrammar::Group& group = *plan.groups[d];
+                if (current_.rank[d] + 1 >= group.size()) continue;
+                Node child = current_;
+                child.score += group.score(current_.rank[d] + 1) - group.score(current_.rank[d]);
+                ++child.rank[d];
+                child.last = static_cast<uint8_t>(d);
+                heap_.push(child);
+            }
+            std::fill(filler_, filler_ + PcfgGrammar::k_max_segments, 0);
+            expanding_ = true;
+        }
+
+        // Compose the guess for the current fillers, then advance them like an odometer
+        const Plan& plan = plans_[current_.structure];
+        const size_t segments = plan.groups.size();
+        buffer_.assign(StringView());
+        for (size_t s = 0; s < segments; ++s) {
+            const PcfgGrammar::Group& group = *plan.groups[s];
+            const StringView terminal = group.terminal(current_.rank[s]);
+            if (group.symbol_class != PcfgGrammar::CLASS_LETTER) {
+                buffer_.append(terminal);
+                continue;
+            }
+            char* word = buffer_.data() + buffer_.size();
+            buffer_.append(StringView(fillers_[group.length].data() + filler_[s] * group.length, group.length));
+            for (size_t k = 0; k < group.length; ++k) {
+                if (terminal[k] == 'U') word[k] = static_cast<char>(word[k] - 'a' + 'A');
+            }
+        }
+        guess = buffer_.view();
+        score = current_.score;
+        expanding_ = false;
+        for (size_t s = segments; s-- > 0;) {
+            const PcfgGrammar::Group& group = *plan.groups[s];
+            if (group.symbol_class != PcfgGrammar::CLASS_LETTER) continue;
+            if (++filler_[s] < fillers_[group.length].size() / group.length) {
+                expanding_ = true;
+                break;
+            }
+            filler_[s] = 0;
+        }
+        return true;
+    }
+
+    /** @return The number of structures that can be filled from the lists. */
+    size_t usable_structures() const { return plans_.size(); }
+
+    /** @return The number of distinct letter-only words available as fillers. */
+    size_t filler_count() const {
+        size_t words = 0;
+        for (size_t length = 1; length < fillers_.size(); ++length) words += fillers_[length].size() / length;
+        return words;
+    }
+
+    /** @return Pre-terminals waiting in the priority queue (the frontier). */
+    size_t frontier() const { return heap_.size(); }
+
+private:
+    /** @brief A usable structure with its terminal groups resolved. */
+    struct Plan {
+        std::vector<const PcfgGrammar::Group*> groups; // One per run
+        double score;                                  // log P(structure) - sum of log(fillers) over letter runs
+    };
+
+    /** @brief A pre-terminal: a terminal rank for each run of a structure. */
+    struct Node {
+        double score;
+        uint32_t structure;                         // Index into plans_
+        uint8_t last;                               // Run of the last increment (children only go from here on)
+        uint32_t rank[PcfgGrammar::k_max_segments]; // Terminal rank of each run
+
+        bool operator<(const Node& other) const {
+            return score < other.score || (score == other.score && structure > other.structure);
+        }
+    };
+
+    std::vector<Plan> plans_;
+    std::vector<std::string> fillers_;           // fillers_[n]: the n-letter fillers back to back
+    std::priority_queue<Node> heap_;             // Frontier, best first
+    Node current_;                               // Pre-terminal being expanded
+    bool expanding_;                             // current_ has guesses left
+    size_t filler_[PcfgGrammar::k_max_segments]; // Filler index of each letter run of current_
+    CandidateBuffer buffer_;                     // The guess being returned
+};
+
+// --- Parallel Generation ---
+
+/**
+ * @brief Emits the printable, non-empty base words in [begin, end) to a sink.
+ */
+void emit_base_words(const StringView* begin, const StringView* end, CandidateSink& candidates) {
+    ThreadStats& stats = Stats::local();
+    for (const StringView* it = begin; it != end; ++it) {
+        ThreadStats::add(stats.progress, 1);
+        if (!is_printable(*it) || it->empty() || it->size() > CandidateBuffer::k_capacity) continue;
+        candidates.emit(*it);
+        ThreadStats::add(stats.stages[STAT_COMBINE].produced, 1);
+    }
+}
+
+/**
+ * @brief Selects the slice of the base words that belongs to one shard.
+ * Every candidate is derived from exactly one base word and all positions of a
+ * base word are contiguous in the keyspace, so contiguous base word ranges
+ * split both the generation work and the keyspace into N disjoint parts whose
+ * concatenation (in shard order) is the unsharded output.
+ * @param base_words All base words.
+ * @param index Zero-based shard number.
+ * @param count Total number of shards.
+ * @return The base words of the shard (empty if there are more shards than words).
+ */
+std::vector<StringView> select_shard(const std::vector<StringView>& base_words,
+                                     unsigned index, unsigned count) {
+    const uint64_t total = base_words.size();
+    const size_t first = static_cast<size_t>(total * index / count);
+    const size_t last = static_cast<size_t>(total * (index + 1) / count);
+    return std::vector<StringView>(base_words.begin() + first, base_words.begin() + last);
+}
+
+/**
+ * @brief Resolves a --threads value: 0 means one thread per hardware core.
+ */
+unsigned resolve_thread_count(unsigned requested) {
+    if (requested != 0) return requested;
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores == 0 ? 1 : cores;
+}
+
+/**
+ * @brief Multi-threaded generate_target_combinations() for the default (set) mode.
+ * The base word list is split into one contiguous range per thread and every
+ * worker de-duplicates into its own CandidateSet shard. The shards are merged
+ * into candidates in range order as the workers finish; because the ranges are
+ * contiguous, the merged insertion order is exactly the single-threaded order.
+ * @param base_words The base words.
+ * @param target_info The target-specific strings.
+ * @param config Suffixes and case forms to combine.
+ * @param threads Number of worker threads (>= 1).
+ * @param candidates The set that receives the unique candidates.
+ */
+void generate_target_combinations_parallel(const std::vector<StringView>& base_words,
+                                           const std::vector<StringView>& target_info,
+                                           const CombinatorConfig& config,
+                                           unsigned threads,
+                                           CandidateSet& candidates) {
+    std::cerr << "[*] Generating target combinations on " << threads << " threads..." << std::endl;
+    const StringView* words = base_words.data();
+    const size_t count = base_words.size();
+
+    std::vector<std::unique_ptr<CandidateSet>> shards(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        const size_t begin = count * t / threads;
+        const size_t end = count * (t + 1) / threads;
+        shards[t].reset(new CandidateSet((end - begin) * 16));
+        workers.emplace_back([&, t, begin, end]() {
+            SetSink shard_sink(*shards[t], false); // Kept candidates are counted by the merge
+            generate_target_combinations(words + begin, words + end, target_info, config, shard_sink);
+        });
+    }
+    ThreadStats::Counters& stats = Stats::local().stages[STAT_DEDUP];
+    for (unsigned t = 0; t < threads; ++t) {
+        workers[t].join();
+        const size_t added = candidates.merge(*shards[t]);
+        ThreadStats::add(stats.produced, added);
+        ThreadStats::add(stats.rejected, shards[t]->size() - added); // Repeats across shards
+        shards[t].reset(); // Release the shard before merging the next one
+    }
+    std::cerr << "[*] Finished target combinations." << std::endl;
+}
+
+/**
+ * @brief Tells a chunk producer that the output limit has been reached.
+ * Passed to the produce callback of run_chunks_parallel(), so a long chunk can
+ * stop generating once --top is satisfied instead of running to its end.
+ */
+class ChunkLimit {
+public:
+    ChunkLimit(const std::atomic<uint64_t>& written, uint64_t limit) : written_(written), limit_(limit) {}
+
+    /** @return true once the limit (if any) has been written. */
+    bool operator()() const { return limit_ != 0 && written_.load(std::memory_order_relaxed) >= limit_; }
+
+private:
+    const std::atomic<uint64_t>& written_; // Candidates written so far
+    uint64_t limit_;                       // 0 = no limit
+};
+
+/**
+ * @brief Runs independent output chunks on worker threads and writes them out.
+ * Workers claim chunk numbers from a shared counter, generate each chunk into
+ * a local BufferSink (own buffer and duplicate filter, reset per chunk) and
+ * hand it to the writer in pieces of at most about k_piece_bytes. With ordered
+ * set, chunks are written strictly in chunk order, so the output is identical
+ * from run to run regardless of thread timing: a worker whose chunk is not up
+ * yet waits with one full piece before generating more. Otherwise pieces are
+ * written as soon as they are ready. Memory stays bounded at about one piece
+ * per thread, however large a chunk is.
+ * @param chunk_count Number of chunks.
+ * @param threads Number of worker threads (>= 1).
+ * @param ordered Write chunks in chunk order.
+ * @param recent_cache_bits Size of each worker's RecentFilter (0 = no filtering).
+ * @param writer The output stage.
+ * @param produce Called as produce(chunk, sink, limit_reached) to generate one
+ *        chunk; limit_reached() (a ChunkLimit) turns true once limit is written.
+ * @param limit Stop after this many candidates (0 = no limit): chunks claimed
+ *        once it is reached are skipped and the piece that reaches it is cut short.
+ * @return The number of candidates written.
+ */
+template <typename Produce>
+size_t run_chunks_parallel(size_t chunk_count, unsigned threads, bool ordered,
+                           unsigned recent_cache_bits, OutputWriter& writer, Produce produce,
+                           uint64_t limit = 0) {
+    const size_t k_piece_bytes = 1 << 20;
+    std::atomic<size_t> next_chunk(0);
+    std::atomic<uint64_t> written(0); // Only changed under output_mutex
+    std::mutex output_mutex;
+    std::condition_variable chunk_written;
+    size_t next_to_write = 0; // Guarded by output_mutex (ordered mode)
+    const ChunkLimit limit_reached(written, limit);
+
+    auto worker = [&]() {
+        BufferSink buffer(recent_cache_bits);
+        ThreadStats& stats = Stats::local();
+        size_t chunk = 0;
+        size_t piece_start = 0; // buffer.emitted() when the buffer was last emptied
+        // Writes the buffered candidates once the chunk is up; the last piece passes the turn on
+        auto write_piece = [&](bool last_piece) {
+            size_t count = buffer.emitted() - piece_start;
+            size_t bytes = buffer.buffer().size();
+            {
+                std::unique_lock<std::mutex> lock(output_mutex);
+                if (ordered) {
+                    chunk_written.wait(lock, [&]() { return next_to_write == chunk; });
+                }
+                if (limit != 0 && count > limit - written) {
+                    // Keep the first (limit - written) lines of the piece
+                    count = static_cast<size_t>(limit - written);
+                    const char* data = buffer.buffer().data();
+                    bytes = 0;
+                    for (size_t line = 0; line < count; ++line) {
+                        bytes = static_cast<const char*>(std::memchr(data + bytes, '\n', buffer.buffer().size() - bytes)) - data + 1;
+                    }
+                }
+                writer.write_block(buffer.buffer().data(), bytes);
+                written += count;
+                if (last_piece) ++next_to_write;
+            }
+            stats.add_output(count, bytes);
+            if (ordered && last_piece) chunk_written.notify_all();
+            buffer.clear_buffer();
+            piece_start = buffer.emitted();
+        };
+        buffer.set_drain(k_piece_bytes, [&]() { write_piece(false); });
+        for (;;) {
+            chunk = next_chunk.fetch_add(1);
+            if (chunk >= chunk_count) break;
+
+            buffer.reset();
+            piece_start = buffer.emitted();
+            if (!limit_reached()) produce(chunk, static_cast<CandidateSink&>(buffer), limit_reached);
+            write_piece(true);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) workers.emplace_back(worker);
+    for (std::thread& w : workers) w.join();
+    return static_cast<size_t>(written);
+}
+
+/**
+ * @brief Multi-threaded streaming generation (combinations + transforms) to a writer.
+ * The base words are cut into chunks sized to produce roughly
+ * k_stream_chunk_candidates candidates each and run through
+ * run_chunks_parallel().
+ * @param base_words The base words.
+ * @param target_info The target-specific strings (may be empty).
+ * @param config Suffixes and case forms to combine.
+ * @param transforms Leetspeak and rule stages applied to every candidate.
+ * @param threads Number of worker threads (>= 1).
+ * @param ordered Write chunks in base-word order.
+ * @param writer The output stage.
+ * @param filter Shared approximate de-duplication filter (nullptr = only
+ *        nearby duplicates are removed, per chunk).
+ * @return The number of candidates written.
+ */
+size_t stream_parallel(const std::vector<StringView>& base_words,
+                       const std::vector<StringView>& target_info,
+                       const CombinatorConfig& config,
+                       const TransformConfig& transforms,
+                       unsigned threads, bool ordered,
+                       OutputWriter& writer, BloomFilter* filter = nullptr) {
+    const size_t k_stream_chunk_candidates = 1 << 18;
+    // Rough candidates per base word: (2 + 4 per case form) combinations per
+    // target info entry, plus (4 + 4 per case form) per suffix, multiplied by
+    // the transform stages
+    const size_t forms = config.case_forms.size();
+    const size_t per_info = (2 + 4 * forms) + config.suffixes.size() * (4 + 4 * forms);
+    const size_t expansion = (transforms.leet != nullptr ? 1 + std::min<size_t>(transforms.leet_max_variants, 8) : 1) *
+                             (transforms.rules != nullptr ? std::max<size_t>(1, transforms.rules->size()) : 1);
+    const size_t per_word = (2 + target_info.size() * per_info) * expansion;
+    const size_t chunk_words = std::max<size_t>(1, k_stream_chunk_candidates / per_word);
+    const size_t chunk_count = (base_words.size() + chunk_words - 1) / chunk_words;
+    const StringView* words = base_words.data();
+
+    return run_chunks_parallel(chunk_count, threads, ordered, filter != nullptr ? 0 : 16, writer,
+                               [&](size_t chunk, CandidateSink& buffer, const ChunkLimit&) {
+        const StringView* begin = words + chunk * chunk_words;
+        const StringView* end = words + std::min(base_words.size(), (chunk + 1) * chunk_words);
+        std::unique_ptr<ApproxDedupSink> dedup(filter != nullptr ? new ApproxDedupSink(*filter, buffer) : nullptr);
+        TransformChain chain(transforms, dedup ? static_cast<CandidateSink&>(*dedup) : buffer);
+        if (!target_info.empty()) {
+            // generate_target_combinations() emits every base word itself
+            generate_target_combinations(begin, end, target_info, config, chain.input());
+        } else {
+            emit_base_words(begin, end, chain.input());
+        }
+    });
+}
+
+/**
+ * @brief Streams the strings of a MarkovModel level by level up to a threshold.
+ * Each level is split by prefix (the first model.order() characters) into one
+ * chunk per (level, prefix), run through run_chunks_parallel() in chunk order:
+ * the output never mixes levels and is the same for any number of threads.
+ * Chunks grow with the level, so they are written in pieces as they fill, and
+ * a chunk stops generating as soon as limit candidates have been written.
+ * Markov strings are distinct by construction, so nothing is de-duplicated.
+ * @param model The trained model.
+ * @param max_level Highest level enumerated (the probability threshold).
+ * @param threads Number of worker threads (>= 1).
+ * @param exclude Candidates to suppress (nullptr = none).
+ * @param limit Stop after this many candidates (0 = everything up to max_level).
+ * @param writer The output stage.
+ * @return The number of candidates written.
+ */
+size_t stream_markov(const MarkovModel& model, unsigned max_level, unsigned threads,
+                     const XorFilter* exclude, uint64_t limit, OutputWriter& writer) {
+    const size_t prefixes = model.prefix_count();
+    if (threads <= 1) {
+        StreamSink output(writer, 0); // Distinct by construction
+        std::unique_ptr<ExcludeSink> filter(exclude != nullptr ? new ExcludeSink(*exclude, output) : nullptr);
+        CandidateSink& input = filter ? static_cast<CandidateSink&>(*filter) : output;
+        auto done = [&]() { return limit != 0 && output.emitted() >= limit; };
+        for (unsigned level = 0; level <= max_level && !done(); ++level) {
+            for (size_t prefix = 0; prefix < prefixes && !done(); ++prefix) {
+                generate_markov(model, level, prefix, input, done);
+            }
+        }
+        return output.emitted();
+    }
+    return run_chunks_parallel(static_cast<size_t>(max_level + 1) * prefixes, threads, true, 0, writer,
+                               [&](size_t chunk, CandidateSink& buffer, const ChunkLimit& limit_reached) {
+        std::unique_ptr<ExcludeSink> filter(exclude != nullptr ? new ExcludeSink(*exclude, buffer) : nullptr);
+        generate_markov(model, static_cast<unsigned>(chunk / prefixes), chunk % prefixes,
+                        filter ? static_cast<CandidateSink&>(*filter) : buffer, limit_reached);
+    }, limit);
+}
+
+/**
+ * @brief Writes every candidate in the keyspace range [first, last) in index order.
+ * No de-duplication is applied, so the output of adjacent ranges concatenates
+ * to exactly the output of their union. With several threads the range is cut
+ * into fixed-size chunks that are always written in order.
+ * @param keyspace The keyspace model.
+ * @param first First position to emit.
+ * @param last One past the last position to emit.
+ * @param threads Number of worker threads (>= 1).
+ * @param writer The output stage.
+ * @return The number of candidates written.
+ */
+size_t emit_keyspace_range(const Keyspace& keyspace, uint64_t first, uint64_t last,
+                           unsigned threads, OutputWriter& writer) {
+    if (threads <= 1) {
+        KeyspaceCursor cursor(keyspace);
+        ThreadStats& stats = Stats::local();
+        return cursor.for_each(first, last, [&](StringView candidate) {
+            writer.write_line(candidate);
+            stats.add_output(1, candidate.size() + 1);
+        });
+    }
+    const uint64_t k_chunk_positions = 1 << 18;
+    const uint64_t chunk_count = (last - first + k_chunk_positions - 1) / k_chunk_positions;
+    return run_chunks_parallel(static_cast<size_t>(chunk_count), threads, true, 0, writer,
+                               [&](size_t chunk, CandidateSink& buffer, const ChunkLimit&) {
+        const uint64_t begin = first + chunk * k_chunk_positions;
+        const uint64_t end = std::min(last, begin + k_chunk_positions);
+        KeyspaceCursor cursor(keyspace);
+        cursor.for_each(begin, end, [&](StringView candidate) { buffer.emit(candidate); });
+    });
+}
+
+// --- Pipelined Execution ---
+
+/**
+ * @brief A block of candidates passed between pipeline stages.
+ * Candidates are stored back to back, each followed by '\n', so the last
+ * stage hands the bytes to the writer as they are.
+ */
+class CandidateBatch {
+public:
+    static const size_t k_bytes = 64 << 10;        // A batch is handed on once it holds this much
+    static const size_t k_count = k_bytes / 2;     // ... or this many candidates (1-byte ones)
+    static const size_t k_max_candidate = RuleSet::k_buffer_size; // Longest candidate any stage emits
+    static_assert(CandidateBuffer::k_capacity <= k_max_candidate, "Combinator output must fit in a batch");
+
+    CandidateBatch() : bytes_(k_bytes + k_max_candidate + 1), offsets_(k_count + 1), count_(0) {}
+
+    void clear() { count_ = 0; }
+
+    /** @brief Appends a candidate (at most k_max_candidate bytes) and its newline. */
+    void append(StringView candidate) {
+        const uint32_t start = offsets_[count_];
+        std::memcpy(&bytes_[start], candidate.data(), candidate.size());
+        bytes_[start + candidate.size()] = '\n';
+        offsets_[++count_] = start + static_cast<uint32_t>(candidate.size()) + 1;
+    }
+
+    bool full() const { return offsets_[count_] >= k_bytes || count_ == k_count; }
+
+    /** @return The number of candidates in the batch. */
+    size_t size() const { return count_; }
+
+    /** @return Candidate i (without its newline). */
+    StringView at(size_t i) const { return StringView(&bytes_[offsets_[i]], offsets_[i + 1] - offsets_[i] - 1); }
+
+    /** @return The newline-terminated candidates, back to back. */
+    const char* data() const { return bytes_.data(); }
+
+    /** @return The number of bytes in data(). */
+    size_t bytes() const { return offsets_[count_]; }
+
+private:
+    std::vector<char> bytes_;       // Newline-terminated candidates
+    std::vector<uint32_t> offsets_; // offsets_[i] = start of candidate i; offsets_[0] = 0
+    size_t count_;                  // Candidates in the batch
+};
+
+/**
+ * @brief Bounded lock-free single-producer/single-consumer ring buffer.
+ * Exactly one thread may push and one other thread may pop. Each side keeps a
+ * cached copy of the other side's index and only reloads it (one cache miss)
+ * when the ring looks full or empty.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    /** @param capacity Number of slots (rounded up to a power of two). */
+    explicit SpscQueue(size_t capacity)
+        : head_(0), tail_cache_(0), tail_(0), head_cache_(0) {
+        size_t slots = 1;
+        while (slots < capacity) slots <<= 1;
+        slots_.resize(slots);
+        mask_ = slots - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /** @brief Producer side. @return false if the ring is full. */
+    bool try_push(const T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == slots_.size()) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == slots_.size()) return false;
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @brief Consumer side. @return false if the ring is empty. */
+    bool try_pop(T& item) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return false;
+        }
+        item = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_;                                  // slots_.size() - 1
+    alignas(64) std::atomic<size_t> head_;         // Next slot to pop (written by the consumer)
+    size_t tail_cache_;                            // Consumer's copy of tail_
+    alignas(64) std::atomic<size_t> tail_;         // Next slot to push (written by the producer)
+    size_t head_cache_;                            // Producer's copy of head_
+};
+
+/**
+ * @brief Waits for a pipeline queue: spins briefly, then yields, then sleeps.
+ * Stages are usually a few batches apart, so the spin catches most waits;
+ * the sleep keeps a stage that is blocked on a slow consumer (e.g. a cracker
+ * that is not reading) from burning a core.
+ */
+class Backoff {
+public:
+    Backoff() : rounds_(0) {}
+
+    void wait() {
+        if (rounds_ < 64) {
+            // Busy spin
+        } else if (rounds_ < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        ++rounds_;
+    }
+
+private:
+    unsigned rounds_;
+};
 
 /**
- * @brief Checks if all characters in a string are printable ASCII characters.
- * Helps filter out potentially problematic binary data read from files.
- * @param s The string to check.
- * @return true if all characters are printable, false otherwise.
+ * @brief Connection between two adjacent pipeline stages.
+ * A fixed set of batches circulates: the producer takes an empty batch, fills
+ * it and publishes it; the consumer receives it and hands it back once done.
+ * Both directions are SPSC rings, so no locks are taken. When all batches are
+ * in flight the producer waits, which propagates backpressure from a slow
+ * stage (ultimately the cracker reading stdout) up to the generator while the
+ * memory in flight stays at k_batches batches per link.
  */
-bool is_printable(const std::string& s) {
-    // std::all_of checks if the predicate (lambda function) returns true for all elements in the range.
-    return std::all_of(s.begin(), s.end(), [](unsigned char c){
-        // std::isprint checks if the character is printable (including space).
-        return std::isprint(c);
+class PipelineLink {
+public:
+    static const size_t k_batches = 8;
+
+    PipelineLink() : full_(k_batches), free_(k_batches), closed_(false) {
+        for (size_t i = 0; i < k_batches; ++i) {
+            batches_[i].reset(new CandidateBatch());
+            free_.try_push(batches_[i].get());
+        }
+    }
+
+    /** @brief Producer: waits for an empty batch. */
+    CandidateBatch* acquire() {
+        CandidateBatch* batch = nullptr;
+        Backoff backoff;
+        while (!free_.try_pop(batch)) backoff.wait();
+        batch->clear();
+        return batch;
+    }
+
+    /** @brief Producer: passes a filled batch on (never waits: every batch has a slot). */
+    void publish(CandidateBatch* batch) { full_.try_push(batch); }
+
+    /** @brief Producer: marks the end of the stream (after the last publish()). */
+    void close() { closed_.store(true, std::memory_order_release); }
+
+    /** @brief Consumer: waits for the next batch. @return nullptr at the end of the stream. */
+    CandidateBatch* receive() {
+        CandidateBatch* batch = nullptr;
+        Backoff backoff;
+        while (!full_.try_pop(batch)) {
+            if (closed_.load(std::memory_order_acquire)) {
+                // Everything published before close() is visible now
+                return full_.try_pop(batch) ? batch : nullptr;
+            }
+            backoff.wait();
+        }
+        return batch;
+    }
+
+    /** @brief Consumer: returns a batch to the producer. */
+    void release(CandidateBatch* batch) { free_.try_push(batch); }
+
+    /**
+     * @brief Consumer: calls f(batch) for every batch until the end of the stream.
+     */
+    template <typename F>
+    void drain(F f) {
+        while (CandidateBatch* batch = receive()) {
+            f(*batch);
+            release(batch);
+        }
+    }
+
+private:
+    std::unique_ptr<CandidateBatch> batches_[k_batches];
+    SpscQueue<CandidateBatch*> full_; // Producer -> consumer
+    SpscQueue<CandidateBatch*> free_; // Consumer -> producer
+    std::atomic<bool> closed_;
+};
+
+/**
+ * @brief Sink that packs candidates into batches and publishes them on a link.
+ * The output end of every pipeline stage except the last.
+ */
+class BatchSink : public CandidateSink {
+public:
+    explicit BatchSink(PipelineLink& link) : link_(link), batch_(link.acquire()) {}
+
+    void emit(StringView candidate) override {
+        batch_->append(candidate);
+        if (batch_->full()) {
+            link_.publish(batch_);
+            batch_ = link_.acquire();
+        }
+    }
+
+    /** @brief Publishes the last (possibly empty) batch and closes the link. */
+    void finish() {
+        link_.publish(batch_);
+        batch_ = nullptr;
+        link_.close();
+    }
+
+private:
+    PipelineLink& link_;
+    CandidateBatch* batch_; // Batch being filled
+};
+
+/**
+ * @brief Streams candidates through a pipeline with one thread per stage.
+ * generate (base words and combinations) -> transform (leetspeak and rules) ->
+ * filter (exclusions and de-duplication) -> write (the calling thread). The
+ * stages overlap, so the output starts at once and the total time is that of
+ * the slowest stage rather than the sum of all of them. The candidates pass
+ * the same sinks in the same order as in the single-threaded streaming mode,
+ * so the output is identical to it.
+ * @param base_words The base words.
+ * @param target_info The target-specific strings (may be empty).
+ * @param config Suffixes and case forms to combine.
+ * @param transforms Leetspeak, rule and exclusion stages.
+ * @param writer The output stage.
+ * @param filter Shared approximate de-duplication filter (nullptr = none).
+ * @param exact Set that removes every repeat (nullptr = only nearby repeats are
+ *        removed, as in --stream).
+ * @return The number of candidates written.
+ */
+size_t stream_pipelined(const std::vector<StringView>& base_words,
+                        const std::vector<StringView>& target_info,
+                        const CombinatorConfig& config,
+                        const TransformConfig& transforms,
+                        OutputWriter& writer,
+                        BloomFilter* filter = nullptr,
+                        CandidateSet* exact = nullptr) {
+    const bool transform_stage = transforms.leet != nullptr || transforms.rules != nullptr;
+    PipelineLink generated;
+    PipelineLink transformed;
+    PipelineLink filtered;
+    PipelineLink& filter_input = transform_stage ? transformed : generated;
+
+    std::vector<std::thread> stages;
+    stages.emplace_back([&]() {
+        BatchSink output(generated);
+        if (!target_info.empty()) {
+            // generate_target_combinations() emits every base word itself
+            generate_target_combinations(base_words.data(), base_words.data() + base_words.size(),
+                                         target_info, config, output);
+        } else {
+            emit_base_words(base_words.data(), base_words.data() + base_words.size(), output);
+        }
+        output.finish();
+    });
+    if (transform_stage) {
+        stages.emplace_back([&]() {
+            BatchSink output(transformed);
+            TransformConfig stage_transforms = transforms;
+            stage_transforms.exclude = nullptr; // Applied by the filter stage
+            TransformChain chain(stage_transforms, output);
+            CandidateSink& input = chain.input();
+            generated.drain([&](const CandidateBatch& batch) {
+                for (size_t i = 0; i < batch.size(); ++i) input.emit(batch.at(i));
+            });
+            output.finish();
+        });
+    }
+    stages.emplace_back([&]() {
+        BatchSink output(filtered);
+        std::unique_ptr<CandidateSink> dedup;
+        if (exact != nullptr) {
+            dedup.reset(new ExactDedupSink(*exact, output));
+        } else if (filter != nullptr) {
+            dedup.reset(new ApproxDedupSink(*filter, output));
+        } else {
+            dedup.reset(new RecentDedupSink(output));
+        }
+        CandidateSink& deduplicated = *dedup;
+        std::unique_ptr<ExcludeSink> exclude(transforms.exclude != nullptr
+                                             ? new ExcludeSink(*transforms.exclude, deduplicated) : nullptr);
+        CandidateSink& input = exclude ? static_cast<CandidateSink&>(*exclude) : deduplicated;
+        filter_input.drain([&](const CandidateBatch& batch) {
+            for (size_t i = 0; i < batch.size(); ++i) input.emit(batch.at(i));
+        });
+        output.finish();
+    });
+
+    ThreadStats& stats = Stats::local();
+    size_t emitted = 0;
+    filtered.drain([&](const CandidateBatch& batch) {
+        writer.write_block(batch.data(), batch.bytes());
+        emitted += batch.size();
+        stats.add_output(batch.size(), batch.bytes());
     });
+    for (std::thread& stage : stages) stage.join();
+    return emitted;
 }
 
-// --- Generation Strategies ---
+// --- External Merge ---
 
 /**
- * @brief Generates password candidates by combining base words with target-specific info.
- * Includes simple concatenations, suffix additions (years, common symbols),
- * and basic capitalization variations.
- * @param base_words A vector of base words (from a general wordlist).
- * @param target_info A vector of target-specific strings (company names, locations, etc.).
- * @param candidates A reference to a set where unique generated candidates will be inserted.
- */
-void generate_target_combinations(const std::vector<std::string>& base_words,
-                                  const std::vector<std::string>& target_info,
-                                  std::set<std::string>& candidates) {
-    std::cerr << "[*] Generating target combinations..." << std::endl; // Use cerr for status messages
-    // Example suffixes - easily expandable
-    const std::vector<std::string> common_suffixes = {"2023", "2024", "2025", "!", "1", "123", "#"};
+ * @brief Bytewise lexicographic order on candidates (the order of sort -u with LC_ALL=C).
+ */
+inline bool candidate_less(StringView a, StringView b) {
+    const int order = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return order < 0 || (order == 0 && a.size() < b.size());
+}
 
-    // Iterate through each base word
-    for (const std::string& base : base_words) {
-        // Skip empty or non-printable base words
-        if (!is_printable(base) || base.empty()) continue;
-        candidates.insert(base); // Always include the base word itself
+/**
+ * @brief Sequential reader of one newline-terminated run file.
+ * Reads with pread(2) into a private buffer, which grows if a single line
+ * does not fit, and exposes the current line as a view into it.
+ */
+class RunReader {
+public:
+    RunReader(int fd, size_t buffer_size)
+        : fd_(fd), buffer_(std::max<size_t>(buffer_size, 4096)), begin_(0), end_(0), offset_(0), done_(false) {}
 
-        // Combine with each piece of target info
-        for (const std::string& info : target_info) {
-            // Skip empty or non-printable target info
-            if (!is_printable(info) || info.empty()) continue;
+    /**
+     * @brief Advances to the next line.
+     * @return false at the end of the run (or on a read error).
+     */
+    bool next() {
+        for (;;) {
+            const char* data = buffer_.data();
+            const void* nl = std::memchr(data + begin_, '\n', end_ - begin_);
+            if (nl != nullptr) {
+                const size_t length = static_cast<const char*>(nl) - (data + begin_);
+                line_ = StringView(data + begin_, length);
+                begin_ += length + 1;
+                return true;
+            }
+            // Keep the partial line, make room and read more
+            std::memmove(buffer_.data(), data + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+            if (end_ == buffer_.size()) buffer_.resize(buffer_.size() * 2);
+            ssize_t n;
+            do {
+                n = ::pread(fd_, buffer_.data() + end_, buffer_.size() - end_, static_cast<off_t>(offset_));
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                done_ = true; // Runs always end with '\n'; a trailing fragment means a short file
+                return false;
+            }
+            end_ += static_cast<size_t>(n);
+            offset_ += static_cast<uint64_t>(n);
+        }
+    }
 
-            // Simple combinations (base+info, info+base)
-            candidates.insert(base + info);
-            candidates.insert(info + base);
+    /** @return The current line (valid until the next call to next()). */
+    StringView line() const { return line_; }
+    /** @return true once the run is exhausted. */
+    bool done() const { return done_; }
 
-            // Combinations with common suffixes
-            for (const std::string& suffix : common_suffixes) {
-                candidates.insert(base + info + suffix);
-                candidates.insert(info + base + suffix);
-                candidates.insert(base + suffix + info); // Less common pattern, but possible
-                candidates.insert(info + suffix + base); // Less common pattern, but possible
+private:
+    int fd_;                   // Run file (owned by the caller)
+    std::vector<char> buffer_; // Read buffer
+    size_t begin_;             // Start of unconsumed bytes in buffer_
+    size_t end_;               // End of valid bytes in buffer_
+    uint64_t offset_;          // File offset of the next read
+    StringView line_;          // Current line
+    bool done_;                // No more lines
+};
+
+/**
+ * @brief Tournament (loser) tree selecting the smallest current line of k runs.
+ * Internal nodes remember the loser of their match and node 0 the overall
+ * winner, so replacing the winner replays only the log2(k) matches on its path
+ * with one comparison each (a binary heap needs about two per level).
+ */
+class LoserTree {
+public:
+    explicit LoserTree(std::vector<RunReader>& runs) : runs_(runs), tree_(std::max<size_t>(1, runs.size())) {
+        tree_[0] = runs_.size() == 1 ? 0 : build(1);
+    }
+
+    /** @return Index of the run holding the smallest line (done() if all are exhausted). */
+    size_t winner() const { return tree_[0]; }
+
+    /** @brief Re-establishes the order after the winner's run has advanced. */
+    void replay() {
+        size_t winner = tree_[0];
+        for (size_t node = (winner + runs_.size()) / 2; node >= 1; node /= 2) {
+            if (less(tree_[node], winner)) std::swap(tree_[node], winner);
+        }
+        tree_[0] = winner;
+    }
+
+private:
+    /** @brief Plays the matches below node; leaves are nodes k..2k-1. */
+    size_t build(size_t node) {
+        if (node >= runs_.size()) return node - runs_.size();
+        size_t left = build(2 * node);
+        size_t right = build(2 * node + 1);
+        if (less(right, left)) std::swap(left, right);
+        tree_[node] = right; // Loser
+        return left;         // Winner moves up
+    }
+
+    /** @brief Exhausted runs compare greater than everything. */
+    bool less(size_t a, size_t b) const {
+        if (runs_[a].done()) return false;
+        if (runs_[b].done()) return true;
+        return candidate_less(runs_[a].line(), runs_[b].line());
+    }
+
+    std::vector<RunReader>& runs_;
+    std::vector<size_t> tree_; // tree_[0] = winner, tree_[1..k-1] = losers
+};
+
+/**
+ * @brief Sink that de-duplicates an unbounded candidate stream with bounded memory.
+ * Candidates are collected in a CandidateSet until it reaches the memory
+ * budget; the set is then sorted and written to a run file in the spill
+ * directory and cleared. merge() combines the runs with a loser tree and
+ * writes the globally unique candidates in sorted order, like sort -u but
+ * without a text round-trip through another process. Run files are unlinked
+ * as soon as they are created, so nothing is left behind if the process dies.
+ */
+class SpillSink : public CandidateSink {
+public:
+    static const size_t k_max_fan_in = 256; // Runs merged in one pass
+
+    /**
+     * @param directory Directory for the temporary run files.
+     * @param memory_budget Bytes the in-memory set may use before it is spilled.
+     */
+    SpillSink(const std::string& directory, size_t memory_budget)
+        : directory_(directory), budget_(memory_budget), set_(1 << 16) {}
+
+    ~SpillSink() {
+        for (int fd : runs_) ::close(fd);
+    }
+
+    SpillSink(const SpillSink&) = delete;
+    SpillSink& operator=(const SpillSink&) = delete;
 
-                // --- Basic Capitalization Variations ---
-                // Create capitalized versions (handle empty strings safely)
-                std::string cap_info = info;
-                if (!cap_info.empty()) cap_info[0] = std::toupper(cap_info[0]);
-                std::string cap_base = base;
-                if (!cap_base.empty()) cap_base[0] = std::toupper(cap_base[0]);
+    void emit(StringView candidate) override {
+        if (!set_.insert(candidate.data(), candidate.size())) {
+            ThreadStats::add(Stats::local().stages[STAT_DEDUP].rejected, 1);
+            return;
+        }
+        // Account for the sort index spill() will need as well
+        if (set_.memory_usage() + set_.size() * sizeof(StringView) >= budget_) spill();
+    }
 
-                // Insert capitalized combinations
-                candidates.insert(cap_base + cap_info); // CapBaseCapInfo
-                candidates.insert(cap_info + cap_base); // CapInfoCapBase
-                candidates.insert(cap_base + info);     // CapBaseinfo
-                candidates.insert(info + cap_base);     // infoCapBase
+    /** @return The number of runs written so far. */
+    size_t runs() const { return runs_.size(); }
 
-                // Insert capitalized combinations with suffixes
-                candidates.insert(cap_base + cap_info + suffix);
-                candidates.insert(cap_info + cap_base + suffix);
-                candidates.insert(cap_base + info + suffix);
-                candidates.insert(info + cap_base + suffix);
+    /**
+     * @brief Writes every unique candidate in sorted order.
+     * Without any spilled run the in-memory set is sorted and written directly.
+     * @param writer The output stage.
+     * @return The number of candidates written.
+     * @throws std::runtime_error if a run file cannot be created or written.
+     */
+    size_t merge(OutputWriter& writer) {
+        if (runs_.empty()) {
+            std::vector<StringView> sorted;
+            sort_set(sorted);
+            for (StringView candidate : sorted) writer.write_line(candidate.data(), candidate.size());
+            Stats::local().add_output(sorted.size(), set_.arena_size());
+            ThreadStats::add(Stats::local().stages[STAT_DEDUP].produced, sorted.size());
+            return sorted.size();
+        }
+        if (!set_.empty()) spill();
+        // Reduce the number of runs until they can be merged in one pass
+        while (runs_.size() > k_max_fan_in) {
+            const int fd = create_run();
+            {
+                OutputWriter run(OutputWriter::k_default_buffer_size, fd);
+                merge_runs(0, k_max_fan_in, run);
+                run.flush();
+                if (!run.ok()) throw std::runtime_error("could not write run file in " + directory_);
             }
+            for (size_t i = 0; i < k_max_fan_in; ++i) ::close(runs_[i]);
+            runs_.erase(runs_.begin(), runs_.begin() + k_max_fan_in);
+            runs_.push_back(fd);
         }
+        const size_t written = merge_runs(0, runs_.size(), writer);
+        ThreadStats::add(Stats::local().stages[STAT_DEDUP].produced, written);
+        return written;
+    }
 
-        // Also combine the base word directly with suffixes
-        for (const std::string& suffix : common_suffixes) {
-             candidates.insert(base + suffix); // baseSuffix
-             // Capitalized base word + suffix
-             std::string cap_base = base;
-             if (!cap_base.empty()) cap_base[0] = std::toupper(cap_base[0]);
-             candidates.insert(cap_base + suffix); // CapBaseSuffix
+private:
+    /** @brief Collects views of the in-memory candidates in sorted order. */
+    void sort_set(std::vector<StringView>& sorted) const {
+        sorted.clear();
+        sorted.reserve(set_.size());
+        set_.for_each([&](StringView candidate) { sorted.push_back(candidate); });
+        std::sort(sorted.begin(), sorted.end(), candidate_less);
+    }
+
+    /** @brief Creates an anonymous (already unlinked) run file. */
+    int create_run() {
+        std::string path = directory_ + "/candidate_generator-run-XXXXXX";
+        const int fd = ::mkstemp(&path[0]);
+        if (fd < 0) throw std::runtime_error("could not create a run file in " + directory_);
+        ::unlink(path.c_str());
+        return fd;
+    }
+
+    /** @brief Sorts the in-memory set into a new run file and empties it. */
+    void spill() {
+        std::vector<StringView> sorted;
+        sort_set(sorted);
+        const int fd = create_run();
+        runs_.push_back(fd);
+        OutputWriter run(OutputWriter::k_default_buffer_size, fd);
+        for (StringView candidate : sorted) run.write_line(candidate.data(), candidate.size());
+        run.flush();
+        if (!run.ok()) throw std::runtime_error("could not write run file in " + directory_);
+        // Start over with a table sized for a run like this one: a table that
+        // kept its last doubling could take most of the budget by itself
+        set_ = CandidateSet(set_.size());
+    }
+
+    /** @brief k-way merges runs_[first, last) into writer, dropping (and counting) repeats. */
+    size_t merge_runs(size_t first, size_t last, OutputWriter& writer) {
+        const size_t count = last - first;
+        std::vector<RunReader> readers;
+        readers.reserve(count);
+        const size_t buffer_size = std::max<size_t>(1 << 16, std::min<size_t>(1 << 20, budget_ / count));
+        for (size_t i = first; i < last; ++i) {
+            readers.emplace_back(runs_[i], buffer_size);
+            readers.back().next();
+        }
+        LoserTree tree(readers);
+        std::string previous;
+        bool have_previous = false;
+        size_t written = 0;
+        for (size_t w = tree.winner(); !readers[w].done(); w = tree.winner()) {
+            const StringView line = readers[w].line();
+            if (!have_previous || line.size() != previous.size() ||
+                std::memcmp(line.data(), previous.data(), line.size()) != 0) {
+                writer.write_line(line.data(), line.size());
+                Stats::local().add_output(1, line.size() + 1);
+                previous.assign(line.data(), line.size());
+                have_previous = true;
+                ++written;
+            } else {
+                ThreadStats::add(Stats::local().stages[STAT_DEDUP].rejected, 1);
+            }
+            readers[w].next();
+            tree.replay();
         }
+        return written;
     }
-    std::cerr << "[*] Finished target combinations." << std::endl;
+
+    std::string directory_;  // Where run files are created
+    size_t budget_;          // Memory budget of set_
+    CandidateSet set_;       // Candidates of the current run
+    std::vector<int> runs_;  // Descriptors of the (unlinked) run files
+};
+
+// --- Checkpointing ---
+
+/**
+ * @brief Progress of a keyspace run, persisted so it can be resumed.
+ * Because every position of the keyspace is addressable, the whole generation
+ * state is the next position to emit: no iteration stack or de-duplication
+ * structure has to be saved (keyspace runs do not de-duplicate). The digest
+ * ties the file to the inputs and options it was taken with.
+ */
+struct Checkpoint {
+    static const char* const k_magic; // First line of every checkpoint file
+
+    uint64_t digest = 0;  // Keyspace::digest() of the run
+    uint64_t next = 0;    // First position not yet delivered to the consumer
+    uint64_t last = 0;    // One past the last position of the run
+    uint64_t emitted = 0; // Candidates delivered so far (informational)
+
+    /**
+     * @brief Writes the checkpoint atomically (temporary file + rename).
+     * @param path Destination file.
+     * @return true on success.
+     */
+    bool save(const std::string& path) const {
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary.c_str(), std::ios::trunc);
+            if (!file) return false;
+            file << k_magic << "\n"
+                 << "digest " << std::hex << digest << std::dec << "\n"
+                 << "next " << next << "\n"
+                 << "last " << last << "\n"
+                 << "emitted " << emitted << "\n";
+            file.flush();
+            if (!file) return false;
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    /**
+     * @brief Reads a checkpoint written by save().
+     * @param path Checkpoint file.
+     * @return true if the file was present and well formed.
+     */
+    bool load(const std::string& path) {
+        std::ifstream file(path.c_str());
+        std::string magic;
+        if (!std::getline(file, magic) || magic != k_magic) return false;
+        std::string key;
+        bool has_digest = false, has_next = false, has_last = false;
+        while (file >> key) {
+            if (key == "digest") has_digest = static_cast<bool>(file >> std::hex >> digest >> std::dec);
+            else if (key == "next") has_next = static_cast<bool>(file >> next);
+            else if (key == "last") has_last = static_cast<bool>(file >> last);
+            else if (key == "emitted") file >> emitted;
+            else return false;
+        }
+        return has_digest && has_next && has_last && next <= last;
+    }
+};
+
+const char* const Checkpoint::k_magic = "candidate_generator checkpoint v1";
+
+/**
+ * @brief Finds the first position of [first, last) whose line was not fully written.
+ * Re-walks the range adding up line lengths until the delivered byte count is
+ * exhausted; a partially written line counts as not delivered.
+ * @param keyspace The keyspace model.
+ * @param first First position of the range.
+ * @param last One past the last position of the range.
+ * @param delivered Bytes of the range's output accepted by write(2).
+ * @param emitted Receives the number of complete candidates among them.
+ * @return The position to resume from.
+ */
+uint64_t first_undelivered_position(const Keyspace& keyspace, uint64_t first, uint64_t last,
+                                    size_t delivered, uint64_t& emitted) {
+    KeyspaceCursor cursor(keyspace);
+    StringView candidate;
+    emitted = 0;
+    for (uint64_t index = first; index < last; ++index) {
+        if (!cursor.at(index, candidate)) continue;
+        if (candidate.size() + 1 > delivered) return index;
+        delivered -= candidate.size() + 1;
+        ++emitted;
+    }
+    return last;
 }
 
 /**
- * @brief Applies simple leetspeak substitutions to a list of words.
- * e->3, a->@, o->0, s->$, i->1 (case-insensitive)
- * @param input_words A vector of words to apply leetspeak to.
- * @param candidates A reference to a set where unique generated candidates (including leetspeak versions) will be inserted.
+ * @brief emit_keyspace_range() that periodically records its progress.
+ * The range is emitted in segments; after each segment the writer is flushed,
+ * so everything before the segment end has been accepted by the kernel, and
+ * the checkpoint is saved once the interval has elapsed. When the consumer
+ * goes away (EPIPE) or SIGINT/SIGTERM arrives, the checkpoint is narrowed to
+ * the first candidate that was not completely written and saved immediately,
+ * so a restored run neither repeats nor skips output (apart from what was
+ * still sitting unread in the pipe).
+ * @param keyspace The keyspace model.
+ * @param threads Number of worker threads (>= 1).
+ * @param writer The output stage.
+ * @param path Checkpoint file.
+ * @param interval_seconds Minimum time between periodic saves.
+ * @param state Progress; state.next and state.last give the range on entry.
+ * @return false if the run stopped early (the checkpoint holds the resume point).
  */
-void apply_leetspeak(const std::vector<std::string>& input_words,
-                       std::set<std::string>& candidates) {
-    std::cerr << "[*] Applying simple leetspeak..." << std::endl;
-    // Iterate through each input word
-    for (const std::string& word : input_words) {
-        // Skip empty or non-printable words
-        if (!is_printable(word) || word.empty()) continue;
-        candidates.insert(word); // Ensure original word is in the set
-
-        // Create a copy to modify for leetspeak
-        std::string leet_word = word;
-
-        // Perform substitutions (case-insensitive by replacing both lower and upper)
-        std::replace(leet_word.begin(), leet_word.end(), 'e', '3');
-        std::replace(leet_word.begin(), leet_word.end(), 'E', '3');
-        std::replace(leet_word.begin(), leet_word.end(), 'a', '@');
-        std::replace(leet_word.begin(), leet_word.end(), 'A', '@');
-        std::replace(leet_word.begin(), leet_word.end(), 'o', '0');
-        std::replace(leet_word.begin(), leet_word.end(), 'O', '0');
-        std::replace(leet_word.begin(), leet_word.end(), 's', '$');
-        std::replace(leet_word.begin(), leet_word.end(), 'S', '$');
-        std::replace(leet_word.begin(), leet_word.end(), 'i', '1');
-        std::replace(leet_word.begin(), leet_word.end(), 'I', '1');
-        std::replace(leet_word.begin(), leet_word.end(), 't', '7'); // Example: adding 't'
-        std::replace(leet_word.begin(), leet_word.end(), 'T', '7'); // Example: adding 'T'
-
-
-        // Only insert the leetspeak version if it's different from the original
-        if (leet_word != word) {
-            candidates.insert(leet_word);
-        }
-        // Note: More complex rules could involve partial substitutions,
-        // checking context, or using more obscure replacements.
+bool emit_keyspace_checkpointed(const Keyspace& keyspace, unsigned threads, OutputWriter& writer,
+                                const std::string& path, unsigned interval_seconds, Checkpoint& state) {
+    const uint64_t k_segment_positions = static_cast<uint64_t>(threads) << 20;
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point last_save = Clock::now();
+
+    std::signal(SIGPIPE, SIG_IGN); // Report a closed pipe as EPIPE instead of dying
+    install_stop_handler(SIGINT);
+    install_stop_handler(SIGTERM);
+
+    writer.flush();
+    bool completed = true;
+    while (state.next < state.last) {
+        if (g_stop_requested) {
+            completed = false;
+            break;
+        }
+        const uint64_t begin = state.next;
+        const uint64_t end = begin + std::min(k_segment_positions, state.last - begin);
+        const size_t bytes_before = writer.bytes_written();
+        const size_t emitted = emit_keyspace_range(keyspace, begin, end, threads, writer);
+        writer.flush();
+        if (!writer.ok()) {
+            uint64_t delivered = 0;
+            state.next = first_undelivered_position(keyspace, begin, end,
+                                                    writer.bytes_written() - bytes_before, delivered);
+            state.emitted += delivered;
+            completed = false;
+            break;
+        }
+        state.next = end;
+        state.emitted += emitted;
+        if (Clock::now() - last_save >= std::chrono::seconds(interval_seconds)) {
+            if (!state.save(path)) {
+                std::cerr << "Warning: Could not write checkpoint file: " << path << std::endl;
+            }
+            last_save = Clock::now();
+        }
     }
-     std::cerr << "[*] Finished leetspeak." << std::endl;
+
+    if (!state.save(path)) {
+        std::cerr << "Error: Could not write checkpoint file: " << path << std::endl;
+    }
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    return completed;
+}
+
+// --- Library API ---
+// libcandgen (see candgen.h): the loading and configuration steps shared by
+// the command line tool, and the pull-style candgen::Generator built on the
+// keyspace model.
+
+/**
+ * @brief Parses a comma-separated list of case forms (lower, cap, upper, toggle).
+ * @param text The list to parse, e.g. "cap,upper". "none" disables case variants.
+ * @param forms Receives the forms in the given order (duplicates removed).
+ * @return true if every entry was recognised.
+ */
+bool parse_case_forms(const std::string& text, std::vector<CaseForm>& forms) {
+    forms.clear();
+    if (text == "none") return true;
+    std::stringstream list(text);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        CaseForm form;
+        if (name == "lower") form = CASE_LOWER;
+        else if (name == "cap") form = CASE_CAPITALIZED;
+        else if (name == "upper") form = CASE_UPPER;
+        else if (name == "toggle") form = CASE_TOGGLED;
+        else return false;
+        if (std::find(forms.begin(), forms.end(), form) == forms.end()) forms.push_back(form);
+    }
+    return !forms.empty();
 }
 
 /**
- * @brief Loads lines from a text file into a vector of strings.
- * Handles potential Windows line endings (\r\n).
- * @param path The path to the file to load.
- * @return A vector containing the lines from the file. Returns an empty vector if file cannot be opened.
+ * @brief Everything a run needs before generation starts.
+ * Holds the loaded lists (only this node's shard of the base words), the
+ * combinator settings and the compiled rules, leetspeak table and
+ * exclusions, wired together in transforms. The views and pointers refer to
+ * members, so the object is neither copied nor moved.
  */
-std::vector<std::string> load_file_lines(const std::string& path) {
-    std::vector<std::string> lines;
-    std::ifstream file(path); // Input file stream
+struct GeneratorInputs {
+    std::vector<StringView> base_words;  // Base words of this shard
+    std::vector<StringView> target_info; // Target info entries
+    CombinatorConfig combinator;
+    RuleSet rules;
+    LeetTable leet_table;
+    XorFilter exclusions;
+    TransformConfig transforms;
+
+    GeneratorInputs() : leet_table(LeetTable::defaults()) {}
+
+    GeneratorInputs(const GeneratorInputs&) = delete;
+    GeneratorInputs& operator=(const GeneratorInputs&) = delete;
+
+    /**
+     * @brief Loads and compiles everything config describes.
+     * @throws std::invalid_argument for an invalid setting.
+     * @throws std::runtime_error if an input cannot be used.
+     */
+    void load(const candgen::Config& config) {
+        std::ostream* log = config.log;
+        if (!parse_case_forms(config.case_forms, combinator.case_forms)) {
+            throw std::invalid_argument("Invalid case forms: " + config.case_forms);
+        }
+        if (config.shard_count == 0 || config.shard_index >= config.shard_count) {
+            throw std::invalid_argument("Invalid shard");
+        }
+        if (config.leet_max_variants == 0 || config.leet_max_variants > k_max_leet_variants) {
+            throw std::invalid_argument("Invalid leet_max_variants: " + std::to_string(config.leet_max_variants));
+        }
+
+        // Lists come from files when a path is given, otherwise from the config
+        std::vector<StringView> all_words;
+        if (!config.base_wordlist_path.empty()) {
+            if (log) *log << "[*] Loading base wordlist: " << config.base_wordlist_path << std::endl;
+            base_file_.load(config.base_wordlist_path);
+            all_words = base_file_.lines();
+        } else {
+            copy_lines(config.base_words, base_strings_, all_words);
+        }
+        if (!config.target_info_path.empty()) {
+            if (log) *log << "[*] Loading target info: " << config.target_info_path << std::endl;
+            info_file_.load(config.target_info_path);
+            target_info = info_file_.lines();
+        } else {
+            copy_lines(config.target_info, info_strings_, target_info);
+            if (log && target_info.empty()) *log << "[*] No target info file provided." << std::endl;
+        }
+        // The base wordlist is the one critical input
+        if (all_words.empty()) {
+            throw std::runtime_error(config.base_wordlist_path.empty()
+                                         ? std::string("Base wordlist is empty")
+                                         : "Base wordlist is empty or could not be read from " +
+                                               config.base_wordlist_path);
+        }
+
+        // Node i of N keeps only its slice of the base words, which is all it
+        // needs to generate its part of the candidates
+        if (config.shard_count > 1) {
+            base_words = select_shard(all_words, config.shard_index, config.shard_count);
+            if (log) {
+                *log << "[*] Shard " << (config.shard_index + 1) << "/" << config.shard_count << ": "
+                     << base_words.size() << " of " << all_words.size() << " base words." << std::endl;
+            }
+        } else {
+            base_words.swap(all_words);
+        }
+
+        if (!config.rules_path.empty()) {
+            if (log) *log << "[*] Loading rules: " << config.rules_path << std::endl;
+            if (!rules.load(config.rules_path) || rules.empty()) {
+                throw std::runtime_error("No usable rules in " + config.rules_path);
+            }
+            if (log) *log << "[*] Compiled " << rules.size() << " rules." << std::endl;
+        }
+        if (!config.leet_table_path.empty()) {
+            if (log) *log << "[*] Loading leetspeak table: " << config.leet_table_path << std::endl;
+            if (!leet_table.load(config.leet_table_path)) {
+                throw std::runtime_error("No usable substitutions in " + config.leet_table_path);
+            }
+        }
+        if (!config.exclude_paths.empty()) {
+            std::vector<uint64_t> keys;
+            for (const std::string& path : config.exclude_paths) {
+                if (log) *log << "[*] Loading exclusions: " << path << std::endl;
+                // Running without a requested exclusion list would re-emit what it excludes
+                if (!load_exclusions(path, keys)) throw std::runtime_error("Could not read exclusion list " + path);
+            }
+            exclusions.build(keys);
+            if (log) {
+                *log << "[*] Excluding " << keys.size() << " known candidates (" << (exclusions.memory() >> 10)
+                     << " KiB xor filter)." << std::endl;
+            }
+        }
+
+        transforms.leet = &leet_table;
+        transforms.leet_max_variants = config.leet_all ? config.leet_max_variants : 1;
+        transforms.rules = rules.empty() ? nullptr : &rules;
+        transforms.exclude = config.exclude_paths.empty() ? nullptr : &exclusions;
+    }
 
-    // Check if the file was opened successfully
-    if (!file) {
-        // Print warning to standard error
-        std::cerr << "Warning: Could not open file: " << path << ". Skipping." << std::endl;
-        return lines; // Return empty vector
+private:
+    /** @brief Copies the non-empty entries of lines and points views at the copies. */
+    static void copy_lines(const std::vector<std::string>& lines, std::vector<std::string>& storage,
+                           std::vector<StringView>& views) {
+        for (const std::string& line : lines) {
+            if (!line.empty()) storage.push_back(line);
+        }
+        // Views are taken only once storage no longer grows
+        for (const std::string& line : storage) views.push_back(StringView(line.data(), line.size()));
     }
 
-    std::string line;
-    // Read the file line by line
-    while (std::getline(file, line)) {
-         // Remove potential trailing carriage return ('\r') from Windows files
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
+    Wordlist base_file_;                    // Mapped base wordlist (when read from a file)
+    Wordlist info_file_;                    // Mapped target info (when read from a file)
+    std::vector<std::string> base_strings_; // In-memory base words
+    std::vector<std::string> info_strings_; // In-memory target info
+};
+
+} // namespace detail
+
+// --- Library Interface ---
+
+using namespace detail;
+
+static_assert(CandidateBuffer::k_capacity <= k_max_candidate_length && RuleSet::k_buffer_size <= k_max_candidate_length,
+              "Every candidate must fit into a batch of k_min_batch_capacity bytes");
+
+/**
+ * @brief State behind a Generator: the inputs, a cursor over their keyspace,
+ * the repeat filter of the configured mode, and a candidate that did not fit
+ * into the previous batch.
+ */
+struct Generator::Impl {
+    GeneratorInputs inputs;
+    std::unique_ptr<Keyspace> keyspace;
+    std::unique_ptr<KeyspaceCursor> cursor;
+    DedupMode dedup;
+    RecentFilter recent;                // DEDUP_RECENT
+    std::unique_ptr<BloomFilter> bloom; // DEDUP_APPROX
+    std::unique_ptr<CandidateSet> seen; // DEDUP_EXACT
+    uint64_t next;                      // Next position to decode
+    uint64_t last;                      // End of the range
+    StringView candidate;               // Current candidate (points into the cursor)
+    bool pending;                       // candidate was accepted but not yet returned
+
+    explicit Impl(DedupMode mode) : dedup(mode), recent(mode == DEDUP_RECENT ? 16 : 1),
+                                    next(0), last(0), pending(false) {}
+
+    /** @brief Decodes positions until one yields a new candidate. @return false at the end of the range. */
+    bool advance(ThreadStats& stats) {
+        while (next < last) {
+            if (!cursor->at(next++, candidate)) continue;
+            if (accept()) {
+                if (dedup != DEDUP_NONE) ThreadStats::add(stats.stages[STAT_DEDUP].produced, 1);
+                pending = true;
+                return true;
+            }
+            ThreadStats::add(stats.stages[STAT_DEDUP].rejected, 1);
         }
-        // Add non-empty lines to the vector
-        if (!line.empty()) {
-            lines.push_back(line);
+        return false;
+    }
+
+    /** @return false if the dedup mode has seen candidate before. */
+    bool accept() {
+        switch (dedup) {
+        case DEDUP_RECENT: return recent.insert(candidate.data(), candidate.size());
+        case DEDUP_APPROX: return bloom->insert(candidate.data(), candidate.size());
+        case DEDUP_EXACT: return seen->insert(candidate.data(), candidate.size());
+        default: return true;
         }
     }
-    // File is automatically closed when 'file' goes out of scope
-    return lines;
+};
+
+Generator::Generator(const Config& config) : impl_(new Impl(config.dedup)) {
+    Impl& g = *impl_;
+    g.inputs.load(config);
+    g.keyspace.reset(new Keyspace(g.inputs.base_words, g.inputs.target_info,
+                                  g.inputs.combinator, g.inputs.transforms));
+    if (g.keyspace->overflow()) {
+        throw std::runtime_error("The keyspace exceeds 2^64 positions; reduce the inputs or transforms");
+    }
+    g.cursor.reset(new KeyspaceCursor(*g.keyspace));
+    g.last = g.keyspace->size();
+    if (g.dedup == DEDUP_APPROX) {
+        // The keyspace size bounds the number of distinct candidates
+        g.bloom.reset(new BloomFilter(config.dedup_memory, g.last));
+    } else if (g.dedup == DEDUP_EXACT) {
+        g.seen.reset(new CandidateSet());
+    }
 }
 
+Generator::~Generator() {}
 
-// --- Main Function ---
-int main(int argc, char* argv[]) {
-    // --- Basic Argument Parsing ---
-    // Check if at least the base wordlist path is provided
-    if (argc < 2) {
-        // Print usage instructions to standard error
-        std::cerr << "Usage: " << argv[0] << " <base_wordlist_path> [target_info_path]" << std::endl;
-        std::cerr << "Description: Generates password candidates based on input lists and prints them to stdout." << std::endl;
-        std::cerr << "             Designed to be piped into password cracking tools like John the Ripper or Hashcat." << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "Example (John the Ripper):" << std::endl;
-        std::cerr << "  " << argv[0] << " common_words.txt company_info.txt | john --stdin --format=NT hashes.txt" << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "Example (Hashcat):" << std::endl;
-        std::cerr << "  " << argv[0] << " common_words.txt company_info.txt | hashcat -m 1000 -a 0 hashes.txt" << std::endl;
-        return 1; // Indicate error
+size_t Generator::next_batch(char* buffer, size_t capacity, uint32_t* offsets, size_t max_count) {
+    // With room for the longest candidate every call makes progress, so 0 means done
+    if (capacity < k_min_batch_capacity || max_count == 0) {
+        throw std::invalid_argument("next_batch() needs room for at least one candidate of up to " +
+                                    std::to_string(k_max_candidate_length) + " bytes");
     }
+    Impl& g = *impl_;
+    ThreadStats& stats = Stats::local();
+    const uint64_t start = g.next;
+    capacity = std::min<size_t>(capacity, UINT32_MAX); // Offsets are 32-bit
+    size_t count = 0;
+    size_t used = 0;
+    offsets[0] = 0;
+    while (count < max_count && (g.pending || g.advance(stats))) {
+        const size_t size = g.candidate.size() + 1;
+        if (size > capacity - used) break; // Kept for the next batch
+        std::memcpy(buffer + used, g.candidate.data(), g.candidate.size());
+        buffer[used + size - 1] = '\n';
+        used += size;
+        g.pending = false;
+        offsets[++count] = static_cast<uint32_t>(used);
+    }
+    ThreadStats::add(stats.progress, g.next - start);
+    ThreadStats::add(stats.stages[STAT_COMBINE].produced, count);
+    return count;
+}
 
-    // Get file paths from command line arguments
-    std::string base_wordlist_path = argv[1];
-    // Check if the optional target info path was provided
-    std::string target_info_path = (argc > 2) ? argv[2] : "";
+uint64_t Generator::keyspace_size() const { return impl_->keyspace->size(); }
 
-    // --- Load Input Data ---
-    std::cerr << "[*] Loading base wordlist: " << base_wordlist_path << std::endl;
-    std::vector<std::string> base_words = load_file_lines(base_wordlist_path);
+void Generator::set_range(uint64_t first, uint64_t last) {
+    Impl& g = *impl_;
+    g.last = std::min(last, g.keyspace->size());
+    g.next = std::min(first, g.last);
+    g.pending = false;
+}
 
-    std::vector<std::string> target_info;
-    if (!target_info_path.empty()) {
-        std::cerr << "[*] Loading target info: " << target_info_path << std::endl;
-        target_info = load_file_lines(target_info_path);
-    } else {
-         std::cerr << "[*] No target info file provided." << std::endl;
+uint64_t Generator::position() const { return impl_->pending ? impl_->next - 1 : impl_->next; }
+
+bool Generator::done() const { return !impl_->pending && impl_->next >= impl_->last; }
+
+bool set_cpu_features(const std::string& name) { return select_cpu_features(name); }
+
+std::string cpu_features() { return k_cpu_level_names[CpuDispatch::instance().level()]; }
+
+namespace detail {
+
+// --- Command Line Support ---
+
+/**
+ * @brief Parses a non-negative decimal integer option value.
+ * @param text The text to parse.
+ * @param value Receives the parsed number.
+ * @return true if the whole text was a valid number.
+ */
+bool parse_unsigned(const std::string& text, unsigned long long& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+/**
+ * @brief Parses a byte count with an optional K/M/G/T suffix (powers of 1024).
+ * @param text The text to parse, e.g. "65536", "64K", "4M".
+ * @param value Receives the parsed number of bytes.
+ * @return true if the text was a valid non-zero size that fits in size_t.
+ */
+bool parse_size(const std::string& text, size_t& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = std::strtoull(text.c_str(), &end, 10);
+    if (errno != 0) return false;
+    const std::string suffix(end);
+    unsigned shift = 0;
+    if (suffix == "K" || suffix == "k") shift = 10;
+    else if (suffix == "M" || suffix == "m") shift = 20;
+    else if (suffix == "G" || suffix == "g") shift = 30;
+    else if (suffix == "T" || suffix == "t") shift = 40;
+    else if (!suffix.empty()) return false;
+    // Reject rather than wrap: 20000000T would otherwise shift into a small size
+    if (number == 0 || number > (UINT64_MAX >> shift)) return false;
+    number <<= shift;
+    if (number > SIZE_MAX) return false;
+    value = static_cast<size_t>(number);
+    return true;
+}
+
+/**
+ * @brief Checks a --case list without keeping the parsed forms.
+ * @return true if parse_case_forms() accepts text.
+ */
+bool valid_case_forms(const std::string& text) {
+    std::vector<CaseForm> forms;
+    return parse_case_forms(text, forms);
+}
+
+const unsigned k_markov_max_order = MarkovModel::k_max_order;
+const unsigned k_markov_max_level = MarkovModel::k_max_level * (MarkovModel::k_max_length + 1);
+
+/**
+ * @brief Runs the mode the options select and writes its candidates to stdout.
+ * Everything after argument parsing: kernel selection, loading, generation,
+ * output and the statistics report. Progress and errors go to stderr.
+ * @param options Settings from parse_arguments().
+ * @return The process exit status.
+ */
+int run(const Options& options) {
+    // Kernel selection happens before anything touches the input
+    if (!select_cpu_features(options.cpu_features)) {
+        std::cerr << "Error: Unknown or unsupported --cpu-features: " << options.cpu_features << " (this CPU supports up to "
+                  << k_cpu_level_names[CpuDispatch::instance().detected()] << ")." << std::endl;
+        return 1;
+    }
+    if (options.cpu_features != "auto") {
+        std::cerr << "[*] Using " << k_cpu_level_names[CpuDispatch::instance().level()] << " kernels." << std::endl;
     }
 
-    // Exit if the base wordlist is empty (critical input)
-    if (base_words.empty()) {
-         std::cerr << "Error: Base wordlist is empty or could not be read from " << base_wordlist_path << "." << std::endl;
-         return 1; // Indicate error
+    // Candidates bypass iostreams entirely; keep the remaining stream use cheap
+    OutputWriter::untie_standard_streams();
+    OutputWriter writer(options.output_buffer_size);
+
+    // --- Instrumentation ---
+    // The JSON report is written on every exit path, after the last phase ends
+    struct StatsReport {
+        const std::string& path;
+        ~StatsReport() {
+            if (!path.empty() && !Stats::global().write_json(path)) {
+                std::cerr << "Warning: Could not write statistics to " << path << "." << std::endl;
+            }
+        }
+    } stats_report = {options.stats_json_path};
+    ProgressReporter progress(options.progress_interval);
+    Stats& stats = Stats::global();
+
+    // --- PCFG Training ---
+    // A grammar learned for later runs is written without loading any wordlist
+    if (!options.pcfg_save_path.empty()) {
+        stats.begin_phase("train");
+        std::cerr << "[*] Learning grammar from " << options.pcfg_train_path << "..." << std::endl;
+        PcfgGrammar grammar;
+        if (!grammar.train(options.pcfg_train_path)) {
+            std::cerr << "Error: Could not learn a grammar from " << options.pcfg_train_path << "." << std::endl;
+            return 1;
+        }
+        if (!grammar.save(options.pcfg_save_path)) {
+            std::cerr << "Error: Could not write grammar file: " << options.pcfg_save_path << std::endl;
+            return 1;
+        }
+        std::cerr << "[*] Saved " << grammar.structures().size() << " structures and " << grammar.terminal_count()
+                  << " terminals to " << options.pcfg_save_path << "." << std::endl;
+        return 0;
     }
 
-    // --- Candidate Generation ---
-    // Use std::set to automatically store unique candidates
-    std::set<std::string> generated_candidates;
+    stats.begin_phase("load");
 
-    // --- Apply Generation Strategies ---
+    // --- Load Input Data and Configure Strategies ---
+    // libcandgen loads the lists (keeping only this node's shard of the base
+    // words), compiles the rules, leetspeak table and exclusions and wires up
+    // the transform chain
+    GeneratorInputs inputs;
+    try {
+        inputs.load(options.generator);
+    } catch (const std::exception& error) {
+        std::cerr << "Error: " << error.what() << "." << std::endl;
+        return 1;
+    }
+    const std::vector<StringView>& words = inputs.base_words;
+    const std::vector<StringView>& target_info = inputs.target_info;
+    const CombinatorConfig& combinator = inputs.combinator;
+    const TransformConfig& transforms = inputs.transforms;
+    stats.set_progress_total(words.size(), "base words");
+    const unsigned threads = resolve_thread_count(options.threads);
+
+    // --- Keyspace Mode ---
+    // Every position of the combinator x transform grid is addressable, so the
+    // size is known up front and --skip/--limit start anywhere in O(1).
+    if (options.keyspace || options.keyspace_range || !options.checkpoint_path.empty()) {
+        Keyspace keyspace(words, target_info, combinator, transforms);
+        if (keyspace.overflow()) {
+            std::cerr << "Error: The keyspace exceeds 2^64 positions; reduce the inputs or transforms." << std::endl;
+            return 1;
+        }
+        if (options.keyspace) {
+            std::cout << keyspace.size() << std::endl; // Like hashcat --keyspace
+            return 0;
+        }
+        uint64_t first = std::min(options.skip, keyspace.size());
+        uint64_t last = (options.limit == 0 || options.limit > keyspace.size() - first)
+                            ? keyspace.size() : first + options.limit;
+        Checkpoint checkpoint;
+        if (options.restore) {
+            if (!checkpoint.load(options.checkpoint_path)) {
+                std::cerr << "Error: Could not read checkpoint file: " << options.checkpoint_path << std::endl;
+                return 1;
+            }
+            if (checkpoint.digest != keyspace.digest() || checkpoint.last > keyspace.size()) {
+                std::cerr << "Error: Checkpoint " << options.checkpoint_path
+                          << " was taken with different inputs or options." << std::endl;
+                return 1;
+            }
+            first = checkpoint.next;
+            last = checkpoint.last;
+            std::cerr << "[*] Restoring from " << options.checkpoint_path << " (" << checkpoint.emitted
+                      << " candidates already delivered)." << std::endl;
+        }
+        std::cerr << "[*] Keyspace has " << keyspace.size() << " positions; emitting [" << first
+                  << ", " << last << ")..." << std::endl;
+        stats.set_progress_total(last - first, "keyspace positions");
+        stats.begin_phase("keyspace");
+        if (!options.checkpoint_path.empty()) {
+            checkpoint.digest = keyspace.digest();
+            checkpoint.next = first;
+            checkpoint.last = last;
+            const uint64_t emitted_before = checkpoint.emitted;
+            const bool completed = emit_keyspace_checkpointed(keyspace, threads, writer, options.checkpoint_path,
+                                                              options.checkpoint_interval, checkpoint);
+            std::cerr << "[*] Streamed " << (checkpoint.emitted - emitted_before) << " candidates." << std::endl;
+            if (!completed) {
+                std::cerr << "[*] Stopped at keyspace position " << checkpoint.next << "; resume with --restore "
+                          << options.checkpoint_path << std::endl;
+                return 1;
+            }
+            std::cerr << "[*] Candidate generation complete." << std::endl;
+            return 0;
+        }
+        const size_t emitted = emit_keyspace_range(keyspace, first, last, threads, writer);
+        writer.flush();
+        std::cerr << "[*] Streamed " << emitted << " candidates." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
+
+    // --- Probability Mode ---
+    // The keyspace positions are walked best-first by score, so a slow hash
+    // spends its time on the likeliest candidates; repeats are removed by the
+    // selected de-duplication (exact by default).
+    if (options.probability_order) {
+        Keyspace keyspace(words, target_info, combinator, transforms);
+        if (keyspace.overflow()) {
+            std::cerr << "Error: The keyspace exceeds 2^64 positions; reduce the inputs or transforms." << std::endl;
+            return 1;
+        }
+        if (const char* dimension = ProbabilityOrder::oversized_dimension(keyspace)) {
+            std::cerr << "Error: --order probability supports at most " << ProbabilityOrder::k_max_dimension << " "
+                      << dimension << "." << std::endl;
+            return 1;
+        }
+        ScoreModel model;
+        if (!options.train_path.empty()) {
+            std::cerr << "[*] Learning scoring weights from " << options.train_path << "..." << std::endl;
+            if (!model.train(options.train_path, keyspace.bases(), combinator.suffixes, inputs.leet_table)) {
+                std::cerr << "Error: Could not learn weights from " << options.train_path << "." << std::endl;
+                return 1;
+            }
+        }
+        if (!options.weights_path.empty() && !model.load(options.weights_path)) {
+            std::cerr << "Error: Could not read weights file: " << options.weights_path << std::endl;
+            return 1;
+        }
+        if (!options.save_weights_path.empty() && !model.save(options.save_weights_path, combinator.suffixes)) {
+            std::cerr << "Error: Could not write weights file: " << options.save_weights_path << std::endl;
+            return 1;
+        }
+
+        ProbabilityOrder order(keyspace, model, combinator);
+        KeyspaceCursor cursor(keyspace);
+        std::unique_ptr<BloomFilter> filter;
+        std::unique_ptr<CandidateSet> seen;
+        if (options.approx_dedup) {
+            filter.reset(new BloomFilter(options.dedup_memory, options.top != 0 ? options.top : keyspace.size()));
+        } else if (!options.stream) {
+            // Presized for the expected output but capped: the set grows if --top is reached
+            const uint64_t expected = std::min<uint64_t>(options.top != 0 ? options.top : words.size() * 16, keyspace.size());
+            seen.reset(new CandidateSet(static_cast<size_t>(std::min<uint64_t>(expected, 1 << 24))));
+        }
+        StreamSink output(writer, filter || seen ? 0 : 16); // Nearby repeats only with --stream
+        std::unique_ptr<CandidateSink> dedup;
+        if (filter) dedup.reset(new ApproxDedupSink(*filter, output));
+        if (seen) dedup.reset(new ExactDedupSink(*seen, output));
+        CandidateSink& input = dedup ? *dedup : static_cast<CandidateSink&>(output);
+
+        const uint64_t goal = options.top != 0 ? options.top : keyspace.size();
+        std::cerr << "[*] Emitting " << (options.top != 0 ? "the top " : "") << goal
+                  << " candidates in descending probability order..." << std::endl;
+        stats.set_progress_total(goal, "candidates");
+        stats.begin_phase("probability");
+        ThreadStats& local = Stats::local();
+        uint64_t position = 0;
+        double score = 0;
+        StringView candidate;
+        while (output.emitted() < goal && order.next(position, score)) {
+            if (!cursor.at(position, candidate)) continue; // A hole
+            ThreadStats::add(local.stages[STAT_COMBINE].produced, 1);
+            const size_t before = output.emitted();
+            input.emit(candidate);
+            ThreadStats::add(local.progress, output.emitted() - before);
+        }
+        writer.flush();
+        std::cerr << "[*] Outputted " << output.emitted() << " candidates." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
 
-    // 1. Start by adding all printable base words to the candidate set
-    std::cerr << "[*] Initializing candidates with base words..." << std::endl;
-    for(const auto& word : base_words) {
-        if (is_printable(word) && !word.empty()) {
-            generated_candidates.insert(word);
+    // --- PCFG Mode ---
+    // Guesses come from the grammar's structures in probability order, with
+    // the base words and target info in the letter runs. They are distinct by
+    // construction, so no de-duplication is needed.
+    if (!options.pcfg_path.empty() || !options.pcfg_train_path.empty()) {
+        PcfgGrammar grammar;
+        if (!options.pcfg_train_path.empty()) {
+            std::cerr << "[*] Learning grammar from " << options.pcfg_train_path << "..." << std::endl;
+            if (!grammar.train(options.pcfg_train_path)) {
+                std::cerr << "Error: Could not learn a grammar from " << options.pcfg_train_path << "." << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "[*] Loading grammar: " << options.pcfg_path << std::endl;
+            if (!grammar.load(options.pcfg_path)) {
+                std::cerr << "Error: Could not read grammar file: " << options.pcfg_path
+                          << " (expected a file written by --pcfg-save)" << std::endl;
+                return 1;
+            }
+        }
+        PcfgGuesser guesser(grammar, words, target_info);
+        std::cerr << "[*] Grammar has " << grammar.structures().size() << " structures (" << guesser.usable_structures()
+                  << " fillable from " << guesser.filler_count() << " letter-only words) and "
+                  << grammar.terminal_count() << " terminals." << std::endl;
+
+        StreamSink output(writer, 0); // Distinct by construction
+        std::unique_ptr<ExcludeSink> exclude;
+        if (transforms.exclude != nullptr) exclude.reset(new ExcludeSink(*transforms.exclude, output));
+        CandidateSink& input = exclude ? static_cast<CandidateSink&>(*exclude) : output;
+
+        const uint64_t goal = options.top != 0 ? options.top : ~0ULL;
+        std::cerr << "[*] Emitting " << (options.top != 0 ? "the top " + std::to_string(options.top) + " " : "")
+                  << "guesses in descending probability order..." << std::endl;
+        stats.set_progress_total(options.top, "candidates");
+        stats.begin_phase("pcfg");
+        ThreadStats& local = Stats::local();
+        StringView guess;
+        double score = 0;
+        while (output.emitted() < goal && guesser.next(guess, score)) {
+            ThreadStats::add(local.stages[STAT_COMBINE].produced, 1);
+            const size_t before = output.emitted();
+            input.emit(guess);
+            ThreadStats::add(local.progress, output.emitted() - before);
+        }
+        writer.flush();
+        std::cerr << "[*] Outputted " << output.emitted() << " candidates." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
+
+    // --- Markov Mode ---
+    // Strings of a character model trained on the lists themselves, enumerated
+    // level by level up to the threshold: likely "words" that no list contains.
+    if (options.markov) {
+        const size_t k_max_table_bytes = static_cast<size_t>(256) << 20;
+        MarkovModel model(options.markov_order);
+        stats.begin_phase("train");
+        if (!model.train(words, target_info, k_max_table_bytes)) {
+            if (model.table_bytes() > k_max_table_bytes) {
+                std::cerr << "Error: An order " << options.markov_order << " model over " << model.alphabet_size()
+                          << " characters needs " << (model.table_bytes() >> 20) << " MiB of tables; lower --markov-order." << std::endl;
+            } else {
+                std::cerr << "Error: The base words and target info have no printable entry of " << options.markov_order
+                          << " to " << MarkovModel::k_max_length << " characters to learn from." << std::endl;
+            }
+            return 1;
+        }
+        std::cerr << "[*] Markov model: order " << model.order() << " over " << model.alphabet_size() << " characters, "
+                  << ((model.table_bytes() + 1023) >> 10) << " KiB of tables, strings of up to " << model.max_length()
+                  << " characters." << std::endl;
+        if (model.table_bytes() > (static_cast<size_t>(2) << 20)) {
+            std::cerr << "Warning: The tables exceed a typical L2 cache; a lower --markov-order enumerates faster." << std::endl;
+        }
+        std::cerr << "[*] Enumerating levels 0 to " << options.markov_level
+                  << (options.top != 0 ? " (at most " + std::to_string(options.top) + " candidates)" : "")
+                  << (threads > 1 ? " on " + std::to_string(threads) + " threads" : "") << "..." << std::endl;
+        stats.set_progress_total(options.top, "candidates");
+        stats.begin_phase("markov");
+        const size_t emitted = stream_markov(model, options.markov_level, threads, transforms.exclude, options.top, writer);
+        writer.flush();
+        std::cerr << "[*] Streamed " << emitted << " candidates." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
+
+    // --- Spill Mode ---
+    // Exact de-duplication in bounded memory: candidates are collected into
+    // sorted runs on disk and merged, so the output is in sorted order.
+    if (!options.spill_directory.empty()) {
+        std::cerr << "[*] Spilling sorted runs of up to " << (options.spill_memory >> 20) << " MiB to "
+                  << options.spill_directory << "..." << std::endl;
+        try {
+            SpillSink spill(options.spill_directory, options.spill_memory);
+            TransformChain chain(transforms, spill);
+            stats.begin_phase("spill");
+            if (!target_info.empty()) {
+                // generate_target_combinations() emits every base word itself
+                generate_target_combinations(words, target_info, combinator, chain.input());
+            } else {
+                emit_base_words(words.data(), words.data() + words.size(), chain.input());
+            }
+            std::cerr << "[*] Merging " << std::max<size_t>(1, spill.runs()) << " sorted runs..." << std::endl;
+            stats.begin_phase("merge");
+            const size_t emitted = spill.merge(writer);
+            writer.flush();
+            std::cerr << "[*] Outputted " << emitted << " unique candidates." << std::endl;
+        } catch (const std::runtime_error& error) {
+            std::cerr << "Error: Spill mode failed: " << error.what() << "." << std::endl;
+            return 1;
+        }
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
+
+    // --- Streaming Mode ---
+    // Candidates flow through the transforms straight to stdout while they are
+    // generated, so the cracker starts immediately and memory stays bounded.
+    // With --dedup approx a fixed-size Bloom filter takes the place of the
+    // candidate set and removes repeats across the whole run.
+    if (options.stream || options.approx_dedup) {
+        std::unique_ptr<BloomFilter> filter;
+        if (options.approx_dedup) {
+            // The keyspace size bounds the number of distinct candidates
+            Keyspace keyspace(words, target_info, combinator, transforms);
+            const uint64_t expected = keyspace.overflow() ? ~0ULL : keyspace.size();
+            filter.reset(new BloomFilter(options.dedup_memory, expected));
+            std::cerr << "[*] Approximate de-duplication: " << (filter->memory() >> 20) << " MiB blocked Bloom filter, "
+                      << filter->hash_count() << " bits per candidate, false-positive rate ~"
+                      << filter->false_positive_rate() << " at up to " << expected << " candidates." << std::endl;
+        }
+        std::cerr << "[*] Streaming candidates to stdout..." << std::endl;
+        stats.begin_phase("stream");
+        size_t emitted = 0;
+        if (options.pipeline) {
+            emitted = stream_pipelined(words, target_info, combinator, transforms, writer, filter.get());
+        } else if (threads > 1) {
+            emitted = stream_parallel(words, target_info, combinator,
+                                      transforms, threads, options.ordered, writer, filter.get());
+        } else {
+            StreamSink output(writer, filter ? 0 : 16); // The Bloom filter replaces the nearby-repeat filter
+            std::unique_ptr<ApproxDedupSink> dedup(filter ? new ApproxDedupSink(*filter, output) : nullptr);
+            TransformChain chain(transforms, dedup ? static_cast<CandidateSink&>(*dedup) : output);
+            if (!target_info.empty()) {
+                // generate_target_combinations() emits every base word itself
+                generate_target_combinations(words, target_info, combinator, chain.input());
+            } else {
+                emit_base_words(words.data(), words.data() + words.size(), chain.input());
+            }
+            emitted = output.emitted();
         }
+        writer.flush();
+        std::cerr << "[*] Streamed " << emitted << " candidates." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
+
+    // --- Pipelined Mode ---
+    // Exact de-duplication with the stages overlapped: the filter stage keeps
+    // the candidate set and passes every new candidate straight on, so output
+    // starts at once and the set is the only copy of the candidates.
+    if (options.pipeline) {
+        std::cerr << "[*] Generating on a pipeline of stage threads..." << std::endl;
+        stats.begin_phase("pipeline");
+        CandidateSet seen(words.size() * (target_info.empty() ? 2 : 16));
+        const size_t emitted = stream_pipelined(words, target_info, combinator, transforms, writer, nullptr, &seen);
+        writer.flush();
+        std::cerr << "[*] Outputted " << emitted << " unique candidates." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
     }
 
-    // 2. Combine base words with target info (if provided)
-    if (!target_info.empty()) {
+    // --- Candidate Generation ---
+    // Use a CandidateSet (arena-backed hash set) to store unique candidates
+    CandidateSet generated_candidates(words.size() * (target_info.empty() ? 2 : 16));
+    SetSink candidate_sink(generated_candidates);
+
+    // --- Apply Generation Strategies ---
+
+    // 1. Add all printable base words to the candidate set and combine them
+    //    with target info (if provided). generate_target_combinations() emits
+    //    every base word itself, ahead of its combinations, so each candidate
+    //    is produced and counted once, as in the streaming modes
+    stats.begin_phase("combine");
+    if (target_info.empty()) {
+        std::cerr << "[*] Initializing candidates with base words..." << std::endl;
+        emit_base_words(words.data(), words.data() + words.size(), candidate_sink);
+    } else if (threads > 1) {
         // This function modifies generated_candidates directly
-        generate_target_combinations(base_words, target_info, generated_candidates);
+        generate_target_combinations_parallel(words, target_info,
+                                              combinator, threads, generated_candidates);
+    } else {
+        generate_target_combinations(words, target_info, combinator, candidate_sink);
     }
 
-    // 3. Apply leetspeak rules to all candidates generated so far
-    //    Convert the current set to a vector to pass to the function
-    //    (avoids modifying the set while iterating, though apply_leetspeak doesn't iterate its input set)
-    std::vector<std::string> current_candidates_vec(generated_candidates.begin(), generated_candidates.end());
-    // This function also modifies generated_candidates directly
-    apply_leetspeak(current_candidates_vec, generated_candidates);
+    // 2. Apply leetspeak rules to all candidates generated so far
+    //    The set is walked in place and the variants are inserted into it;
+    //    only the candidates present beforehand are visited
+    stats.begin_phase("leet");
+    apply_leetspeak(generated_candidates, inputs.leet_table, transforms.leet_max_variants, candidate_sink);
+
+    // 3. Run the rule file (if any) over every candidate; like hashcat -r, the
+    //    rule outputs replace the candidate set
+    if (transforms.rules != nullptr) {
+        stats.begin_phase("rules");
+        CandidateSet ruled_candidates(generated_candidates.size() * inputs.rules.size());
+        SetSink ruled_sink(ruled_candidates);
+        apply_rules(generated_candidates, inputs.rules, ruled_sink);
+        std::swap(generated_candidates, ruled_candidates);
+    }
 
     // --- Add calls to more generation strategies here ---
     // e.g., date variations, common keyboard walks, Markov chains, etc.
+    // (grammar-based and Markov guessing are modes of their own: see above)
     // Example placeholder:
     // if (enable_date_generation_flag) { // Check if enabled via command line arg
-    //     generate_date_variations(base_words, target_info, generated_candidates);
+    //     generate_date_variations(base_words, target_info, candidate_sink);
     // }
 
 
     // --- Output Candidates to stdout ---
+    stats.begin_phase("output");
+    if (transforms.exclude != nullptr) {
+        // Write the candidates that are not excluded, still in insertion order
+        size_t excluded = 0;
+        size_t excluded_bytes = 0;
+        generated_candidates.for_each([&](StringView candidate) {
+            if (inputs.exclusions.contains(hash_bytes(candidate.data(), candidate.size()))) {
+                ++excluded;
+                excluded_bytes += candidate.size() + 1;
+            } else {
+                writer.write_line(candidate.data(), candidate.size());
+            }
+        });
+        writer.flush();
+        Stats::local().add_output(generated_candidates.size() - excluded,
+                                  generated_candidates.arena_size() - excluded_bytes);
+        ThreadStats::add(Stats::local().stages[STAT_EXCLUDE].rejected, excluded);
+        std::cerr << "[*] Outputted " << (generated_candidates.size() - excluded) << " unique candidates ("
+                  << excluded << " excluded)." << std::endl;
+        std::cerr << "[*] Candidate generation complete." << std::endl;
+        return 0;
+    }
     // Print status message to stderr
     std::cerr << "[*] Outputting " << generated_candidates.size() << " unique candidates to stdout..." << std::endl;
-    // Iterate through the final set of unique candidates
-    for (const std::string& candidate : generated_candidates) {
-        // Print each candidate to standard output, followed by a newline
-        std::cout << candidate << std::endl;
-    }
+    // The set's arena already holds every candidate newline-terminated in
+    // insertion order, so it is handed to the writer as one block
+    writer.write_block(generated_candidates.arena_data(), generated_candidates.arena_size());
+    writer.flush();
+    Stats::local().add_output(generated_candidates.size(), generated_candidates.arena_size());
     // Print final status message to stderr
     std::cerr << "[*] Candidate generation complete." << std::endl;
 
 
     return 0; // Indicate success
 }
+
+} // namespace detail
+} // namespace candgen
@@ -0,0 +1,394 @@
+// candidate_generator: the command line tool.
+//
+// Parses the arguments and runs the selected mode through libcandgen
+// (candgen::detail::run); every generation strategy lives in the library.
+
+#include <iostream> // For usage and error messages on stderr
+#include <string>   // For using std::string
+#include <vector>   // For the positional arguments
+
+#include "candgen_internal.h" // candgen::detail::Options and run()
+
+namespace {
+
+using namespace candgen::detail;
+
+// --- Command Line Handling ---
+
+/**
+ * @brief Parses a --shard value of the form "i/N" (1 <= i <= N).
+ * @param text The text to parse, e.g. "2/8".
+ * @param index Receives the zero-based shard number (i - 1).
+ * @param count Receives the number of shards (N).
+ * @return true if the value is well formed.
+ */
+bool parse_shard(const std::string& text, unsigned& index, unsigned& count) {
+    const size_t slash = text.find('/');
+    if (slash == std::string::npos) return false;
+    unsigned long long i = 0;
+    unsigned long long n = 0;
+    if (!parse_unsigned(text.substr(0, slash), i) || !parse_unsigned(text.substr(slash + 1), n)) return false;
+    if (i == 0 || n == 0 || i > n || n > 1000000) return false;
+    index = static_cast<unsigned>(i - 1);
+    count = static_cast<unsigned>(n);
+    return true;
+}
+
+/**
+ * @brief Prints usage instructions to standard error.
+ * @param program The program name (argv[0]).
+ */
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <base_wordlist_path> [target_info_path]" << std::endl;
+    std::cerr << "Description: Generates password candidates based on input lists and prints them to stdout." << std::endl;
+    std::cerr << "             Designed to be piped into password cracking tools like John the Ripper or Hashcat." << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --stream    Write candidates to stdout as they are generated, using bounded memory." << std::endl;
+    std::cerr << "              Only nearby duplicates are removed in this mode." << std::endl;
+    std::cerr << "  --threads N Generate on N threads (0 = one per CPU core, default 1)." << std::endl;
+    std::cerr << "  --ordered   With --stream and --threads, keep the output order deterministic." << std::endl;
+    std::cerr << "  --order MODE" << std::endl;
+    std::cerr << "              generation: the order the strategies produce (default); probability: the" << std::endl;
+    std::cerr << "              most likely candidates first, scored per pattern, case, suffix and transform." << std::endl;
+    std::cerr << "  --weights FILE" << std::endl;
+    std::cerr << "              Scoring weights for --order probability, as \"key value\" lines." << std::endl;
+    std::cerr << "  --train FILE" << std::endl;
+    std::cerr << "              Learn the scoring weights from a password list (e.g. cracked passwords)." << std::endl;
+    std::cerr << "  --save-weights FILE" << std::endl;
+    std::cerr << "              Write the weights in use (defaults, learned or loaded) to FILE." << std::endl;
+    std::cerr << "  --top N     Stop after the N most likely candidates (with --order probability, a PCFG" << std::endl;
+    std::cerr << "              or --markov)." << std::endl;
+    std::cerr << "  --pcfg FILE Generate from a PCFG grammar (written by --pcfg-save) in probability order," << std::endl;
+    std::cerr << "              filling its letter runs with the base words and target info." << std::endl;
+    std::cerr << "  --pcfg-train FILE" << std::endl;
+    std::cerr << "              Learn a PCFG grammar (structures like L6D4S1, digit/symbol strings and" << std::endl;
+    std::cerr << "              capitalization) from a password list and generate from it." << std::endl;
+    std::cerr << "  --pcfg-save FILE" << std::endl;
+    std::cerr << "              Write the grammar learned by --pcfg-train to FILE and exit; no wordlists needed." << std::endl;
+    std::cerr << "  --markov    Enumerate strings of an order-N character Markov model trained on the base" << std::endl;
+    std::cerr << "              words and target info, likeliest level first (OMEN-style)." << std::endl;
+    std::cerr << "  --markov-order N" << std::endl;
+    std::cerr << "              Characters of context per transition, 1 to 4 (default 2)." << std::endl;
+    std::cerr << "  --markov-level N" << std::endl;
+    std::cerr << "              Highest level to enumerate: the probability threshold (default 20)." << std::endl;
+    std::cerr << "  --pipeline  Run generation, transforms, de-duplication and output on their own threads," << std::endl;
+    std::cerr << "              overlapping them; candidates are written as soon as they are new." << std::endl;
+    std::cerr << "  --case FORMS" << std::endl;
+    std::cerr << "              Case variants combined with the original spelling: comma-separated" << std::endl;
+    std::cerr << "              list of lower, cap, upper, toggle, or none (default cap)." << std::endl;
+    std::cerr << "  --rules FILE" << std::endl;
+    std::cerr << "              Apply every hashcat/JtR rule in FILE to each candidate (like hashcat -r;" << std::endl;
+    std::cerr << "              include a ':' rule to keep the unmodified candidates)." << std::endl;
+    std::cerr << "  --leet-table FILE" << std::endl;
+    std::cerr << "              Leetspeak substitutions, one \"X Y\" pair per line; lines starting with" << std::endl;
+    std::cerr << "              '#' are comments (default: e->3 a->@ o->0 s->$ i->1 t->7, both cases)." << std::endl;
+    std::cerr << "  --leet-mode MODE" << std::endl;
+    std::cerr << "              simple: only the fully substituted form (default); all: every partial" << std::endl;
+    std::cerr << "              form too (p@ssword, passw0rd, ...), capped per word by --leet-max." << std::endl;
+    std::cerr << "  --leet-max N" << std::endl;
+    std::cerr << "              Maximum leetspeak variants per word in --leet-mode all (default 256," << std::endl;
+    std::cerr << "              at most 16777216)." << std::endl;
+    std::cerr << "  --keyspace  Print the number of keyspace positions (combinations x leetspeak" << std::endl;
+    std::cerr << "              variants x rules) to stdout and exit." << std::endl;
+    std::cerr << "  --skip N    Start output at keyspace position N (implies streaming, no de-duplication)." << std::endl;
+    std::cerr << "  --limit N   Emit at most N keyspace positions (implies streaming, no de-duplication)." << std::endl;
+    std::cerr << "  --dedup MODE" << std::endl;
+    std::cerr << "              exact: keep every candidate in memory (default); approx: stream through a" << std::endl;
+    std::cerr << "              fixed-size Bloom filter, which may drop a tiny fraction of candidates." << std::endl;
+    std::cerr << "  --dedup-mem SIZE" << std::endl;
+    std::cerr << "              Memory for --dedup approx, e.g. 256M or 4G (default 512M)." << std::endl;
+    std::cerr << "  --exclude FILE" << std::endl;
+    std::cerr << "              Never emit candidates listed in FILE: a wordlist, or a hashcat/John" << std::endl;
+    std::cerr << "              potfile if the name ends in .pot or .potfile (repeatable)." << std::endl;
+    std::cerr << "  --spill DIR Exact de-duplication beyond RAM: write sorted runs to DIR and merge them." << std::endl;
+    std::cerr << "              The output is in sorted (bytewise) order, like sort -u." << std::endl;
+    std::cerr << "  --spill-mem SIZE" << std::endl;
+    std::cerr << "              Memory used for each run in --spill mode, e.g. 512M (default 1G)." << std::endl;
+    std::cerr << "  --checkpoint FILE" << std::endl;
+    std::cerr << "              Emit the keyspace in order (like --skip 0) and save the position reached" << std::endl;
+    std::cerr << "              to FILE periodically, when the consumer exits and on SIGINT/SIGTERM." << std::endl;
+    std::cerr << "  --restore FILE" << std::endl;
+    std::cerr << "              Resume a --checkpoint run from FILE (same inputs and options) and keep" << std::endl;
+    std::cerr << "              checkpointing to it." << std::endl;
+    std::cerr << "  --checkpoint-interval SECONDS" << std::endl;
+    std::cerr << "              Time between periodic checkpoints (default 30)." << std::endl;
+    std::cerr << "  --shard i/N Generate only shard i of N (1-based): a contiguous slice of the base" << std::endl;
+    std::cerr << "              words, so N nodes split the work and the keyspace without overlap." << std::endl;
+    std::cerr << "  --progress[=SECONDS]" << std::endl;
+    std::cerr << "              Print progress, throughput and ETA to stderr every SECONDS (default 5)." << std::endl;
+    std::cerr << "  --stats-json FILE" << std::endl;
+    std::cerr << "              At exit, write per-stage counters and phase timings to FILE as JSON." << std::endl;
+    std::cerr << "  --cpu-features LEVEL" << std::endl;
+    std::cerr << "              Kernels to use: auto (best the CPU supports, default), scalar, sse2," << std::endl;
+    std::cerr << "              ssse3, avx2 or avx512." << std::endl;
+    std::cerr << "  --output-buffer SIZE" << std::endl;
+    std::cerr << "              Size of the output buffer handed to write(2), e.g. 256K or 4M (default 1M)." << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Example (John the Ripper):" << std::endl;
+    std::cerr << "  " << program << " common_words.txt company_info.txt | john --stdin --format=NT hashes.txt" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Example (Hashcat):" << std::endl;
+    std::cerr << "  " << program << " --stream common_words.txt company_info.txt | hashcat -m 1000 -a 0 hashes.txt" << std::endl;
+}
+
+/**
+ * @brief Parses the command line into an Options structure.
+ * Options start with "--" and may appear anywhere; the remaining arguments are
+ * the base wordlist path followed by the optional target info path.
+ * @param argc Argument count from main().
+ * @param argv Argument vector from main().
+ * @param options Receives the parsed settings.
+ * @return true on success, false if the arguments are invalid (usage should be shown).
+ */
+bool parse_arguments(int argc, char* argv[], Options& options) {
+    std::vector<std::string> positional;
+    bool dedup_given = false; // --dedup, --leet-* and --case given explicitly (for mode conflicts)
+    bool leet_given = false;
+    bool case_given = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        // Fetches the option's value from "--name=value" or the next argument
+        auto take_value = [&](const std::string& name) -> bool {
+            if (arg.compare(0, name.size() + 1, name + "=") == 0) {
+                value = arg.substr(name.size() + 1);
+                return true;
+            }
+            if (arg != name) return false;
+            value = (i + 1 < argc) ? argv[++i] : "";
+            return true;
+        };
+        // Reports a missing or malformed option value
+        auto invalid_value = [&](const std::string& name) -> bool {
+            if (value.empty()) {
+                std::cerr << "Error: Option " << name << " requires a value." << std::endl;
+            } else {
+                std::cerr << "Error: Invalid value for " << name << ": " << value << std::endl;
+            }
+            return false;
+        };
+
+        if (arg == "--stream") {
+            options.stream = true;
+        } else if (take_value("--output-buffer")) {
+            if (!parse_size(value, options.output_buffer_size)) return invalid_value("--output-buffer");
+        } else if (take_value("--threads")) {
+            unsigned long long threads = 0;
+            if (!parse_unsigned(value, threads) || threads > 4096) return invalid_value("--threads");
+            options.threads = static_cast<unsigned>(threads);
+        } else if (arg == "--ordered") {
+            options.ordered = true;
+        } else if (arg == "--pipeline") {
+            options.pipeline = true;
+        } else if (take_value("--rules")) {
+            if (value.empty()) return invalid_value("--rules");
+            options.generator.rules_path = value;
+        } else if (take_value("--leet-table")) {
+            if (value.empty()) return invalid_value("--leet-table");
+            leet_given = true;
+            options.generator.leet_table_path = value;
+        } else if (take_value("--leet-mode")) {
+            leet_given = true;
+            if (value == "simple") options.generator.leet_all = false;
+            else if (value == "all") options.generator.leet_all = true;
+            else return invalid_value("--leet-mode");
+        } else if (take_value("--leet-max")) {
+            unsigned long long max_variants = 0;
+            if (!parse_unsigned(value, max_variants) || max_variants == 0 || max_variants > candgen::k_max_leet_variants) {
+                return invalid_value("--leet-max");
+            }
+            options.generator.leet_max_variants = static_cast<size_t>(max_variants);
+            leet_given = true;
+        } else if (arg == "--keyspace") {
+            options.keyspace = true;
+        } else if (take_value("--skip")) {
+            unsigned long long skip = 0;
+            if (!parse_unsigned(value, skip)) return invalid_value("--skip");
+            options.skip = skip;
+            options.keyspace_range = true;
+        } else if (take_value("--limit")) {
+            unsigned long long limit = 0;
+            if (!parse_unsigned(value, limit) || limit == 0) return invalid_value("--limit");
+            options.limit = limit;
+            options.keyspace_range = true;
+        } else if (take_value("--dedup")) {
+            dedup_given = true;
+            if (value == "exact") options.approx_dedup = false;
+            else if (value == "approx") options.approx_dedup = true;
+            else return invalid_value("--dedup");
+        } else if (take_value("--dedup-mem")) {
+            dedup_given = true;
+            if (!parse_size(value, options.dedup_memory)) return invalid_value("--dedup-mem");
+        } else if (take_value("--exclude")) {
+            if (value.empty()) return invalid_value("--exclude");
+            options.generator.exclude_paths.push_back(value);
+        } else if (take_value("--spill")) {
+            if (value.empty()) return invalid_value("--spill");
+            options.spill_directory = value;
+        } else if (take_value("--spill-mem")) {
+            if (!parse_size(value, options.spill_memory)) return invalid_value("--spill-mem");
+        } else if (take_value("--checkpoint")) {
+            if (value.empty()) return invalid_value("--checkpoint");
+            options.checkpoint_path = value;
+        } else if (take_value("--restore")) {
+            if (value.empty()) return invalid_value("--restore");
+            options.checkpoint_path = value;
+            options.restore = true;
+        } else if (take_value("--checkpoint-interval")) {
+            unsigned long long interval = 0;
+            if (!parse_unsigned(value, interval) || interval > 86400) return invalid_value("--checkpoint-interval");
+            options.checkpoint_interval = static_cast<unsigned>(interval);
+        } else if (arg == "--progress") {
+            options.progress_interval = 5;
+        } else if (arg.compare(0, 11, "--progress=") == 0) {
+            value = arg.substr(11);
+            unsigned long long interval = 0;
+            if (!parse_unsigned(value, interval) || interval == 0 || interval > 86400) {
+                return invalid_value("--progress");
+            }
+            options.progress_interval = static_cast<unsigned>(interval);
+        } else if (take_value("--cpu-features")) {
+            if (value.empty()) return invalid_value("--cpu-features");
+            options.cpu_features = value;
+        } else if (take_value("--order")) {
+            if (value == "probability") options.probability_order = true;
+            else if (value == "generation") options.probability_order = false;
+            else return invalid_value("--order");
+        } else if (take_value("--weights")) {
+            if (value.empty()) return invalid_value("--weights");
+            options.weights_path = value;
+        } else if (take_value("--train")) {
+            if (value.empty()) return invalid_value("--train");
+            options.train_path = value;
+        } else if (take_value("--save-weights")) {
+            if (value.empty()) return invalid_value("--save-weights");
+            options.save_weights_path = value;
+        } else if (take_value("--pcfg")) {
+            if (value.empty()) return invalid_value("--pcfg");
+            options.pcfg_path = value;
+        } else if (take_value("--pcfg-train")) {
+            if (value.empty()) return invalid_value("--pcfg-train");
+            options.pcfg_train_path = value;
+        } else if (take_value("--pcfg-save")) {
+            if (value.empty()) return invalid_value("--pcfg-save");
+            options.pcfg_save_path = value;
+        } else if (arg == "--markov") {
+            options.markov = true;
+        } else if (take_value("--markov-order")) {
+            unsigned long long order = 0;
+            if (!parse_unsigned(value, order) || order == 0 || order > k_markov_max_order) {
+                return invalid_value("--markov-order");
+            }
+            options.markov_order = static_cast<unsigned>(order);
+        } else if (take_value("--markov-level")) {
+            unsigned long long level = 0;
+            if (!parse_unsigned(value, level) || level > k_markov_max_level) {
+                return invalid_value("--markov-level");
+            }
+            options.markov_level = static_cast<unsigned>(level);
+        } else if (take_value("--top")) {
+            unsigned long long top = 0;
+            if (!parse_unsigned(value, top) || top == 0) return invalid_value("--top");
+            options.top = top;
+        } else if (take_value("--stats-json")) {
+            if (value.empty()) return invalid_value("--stats-json");
+            options.stats_json_path = value;
+        } else if (take_value("--shard")) {
+            if (!parse_shard(value, options.generator.shard_index, options.generator.shard_count)) return invalid_value("--shard");
+        } else if (take_value("--case")) {
+            if (!valid_case_forms(value)) return invalid_value("--case");
+            options.generator.case_forms = value;
+            case_given = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown option: " << arg << std::endl;
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (options.approx_dedup && (options.keyspace_range || !options.checkpoint_path.empty())) {
+        std::cerr << "Error: Keyspace runs (--skip/--limit/--checkpoint) are not de-duplicated; drop --dedup approx." << std::endl;
+        return false;
+    }
+    if (!options.spill_directory.empty() &&
+        (options.stream || options.approx_dedup || options.keyspace || options.keyspace_range ||
+         !options.checkpoint_path.empty())) {
+        std::cerr << "Error: --spill cannot be combined with --stream, --dedup approx or keyspace options." << std::endl;
+        return false;
+    }
+    if (options.pipeline && (options.threads != 1 || !options.spill_directory.empty() || options.keyspace ||
+                             options.keyspace_range || !options.checkpoint_path.empty())) {
+        std::cerr << "Error: --pipeline runs one thread per stage; it cannot be combined with --threads, --spill or keyspace options." << std::endl;
+        return false;
+    }
+    if (options.probability_order &&
+        (options.threads != 1 || options.pipeline || !options.spill_directory.empty() || options.keyspace ||
+         options.keyspace_range || !options.checkpoint_path.empty())) {
+        std::cerr << "Error: --order probability cannot be combined with --threads, --pipeline, --spill or keyspace options." << std::endl;
+        return false;
+    }
+    if (!options.probability_order &&
+        (!options.weights_path.empty() || !options.train_path.empty() || !options.save_weights_path.empty())) {
+        std::cerr << "Error: --weights, --train and --save-weights require --order probability." << std::endl;
+        return false;
+    }
+    const bool pcfg = !options.pcfg_path.empty() || !options.pcfg_train_path.empty();
+    if (!options.pcfg_path.empty() && !options.pcfg_train_path.empty()) {
+        std::cerr << "Error: Use either --pcfg or --pcfg-train, not both." << std::endl;
+        return false;
+    }
+    if (!options.pcfg_save_path.empty() && options.pcfg_train_path.empty()) {
+        std::cerr << "Error: --pcfg-save requires --pcfg-train." << std::endl;
+        return false;
+    }
+    if (pcfg && (options.threads != 1 || options.pipeline || options.probability_order ||
+                 !options.spill_directory.empty() || !options.generator.rules_path.empty() || options.keyspace ||
+                 options.keyspace_range || !options.checkpoint_path.empty())) {
+        std::cerr << "Error: --pcfg cannot be combined with --threads, --pipeline, --order probability, --spill, --rules or keyspace options." << std::endl;
+        return false;
+    }
+    if (options.markov && (pcfg || options.pipeline || options.probability_order || !options.spill_directory.empty() ||
+                           !options.generator.rules_path.empty() || options.keyspace || options.keyspace_range ||
+                           !options.checkpoint_path.empty())) {
+        std::cerr << "Error: --markov cannot be combined with --pcfg, --pipeline, --order probability, --spill, --rules or keyspace options." << std::endl;
+        return false;
+    }
+    // Markov strings are distinct by construction and spelled as trained
+    if (options.markov && (options.stream || dedup_given || leet_given || case_given)) {
+        std::cerr << "Error: --markov strings are distinct and used as trained; it cannot be combined with --stream, --dedup, --dedup-mem, --leet-* or --case." << std::endl;
+        return false;
+    }
+    if (options.top != 0 && !options.probability_order && !pcfg && !options.markov) {
+        std::cerr << "Error: --top requires --order probability, --pcfg or --markov." << std::endl;
+        return false;
+    }
+    if (options.restore && options.keyspace_range) {
+        std::cerr << "Error: --restore continues the saved range; it cannot be combined with --skip/--limit." << std::endl;
+        return false;
+    }
+
+    // Check if at least the base wordlist path is provided (only training a grammar needs none)
+    if (positional.empty() && !options.pcfg_save_path.empty()) return true;
+    if (positional.empty() || positional.size() > 2) return false;
+    options.generator.base_wordlist_path = positional[0];
+    // Check if the optional target info path was provided
+    options.generator.target_info_path = (positional.size() > 1) ? positional[1] : "";
+    return true;
+}
+
+} // namespace
+
+// --- Main Function ---
+int main(int argc, char* argv[]) {
+    // --- Basic Argument Parsing ---
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        // Print usage instructions to standard error
+        print_usage(argv[0]);
+        return 1; // Indicate error
+    }
+    options.generator.log = &std::cerr;
+    return run(options);
+}
@@ -0,0 +1,731 @@
+// Behaviour tests for the libcandgen internals.
+//
+// Includes the library source, like the benchmark suite, so the tests can use
+// the classes in candgen::detail directly. Each group is registered as its own
+// CTest test (see CMakeLists.txt); run one by name, or all without arguments:
+//
+//   build/candidate_generator_test candidate_set
+
+#include "../candidate_generator.cpp" // The internals, as one translation unit
+
+#include <limits> // For the initial score bound
+#include <set> // For the expected n-grams and outputs
+
+using namespace candgen::detail;
+
+// --- Test Harness ---
+
+static int g_failures = 0;
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            ++g_failures;                                                                       \
+        }                                                                                       \
+    } while (0)
+
+/**
+ * @brief Reads a whole file.
+ */
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/** @brief The path of a test file in the temporary directory. */
+static std::string temp_path(const std::string& name) {
+    const char* dir = std::getenv("TMPDIR");
+    return std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp") + "/candgen_test_" +
+           std::to_string(::getpid()) + "_" + name;
+}
+
+/**
+ * @brief Writes text to a fresh file in the temporary directory.
+ * @return The path of the file.
+ */
+static std::string write_temp_file(const std::string& name, const std::string& text) {
+    const std::string path = temp_path(name);
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << text;
+    return path;
+}
+
+// --- Tests ---
+
+// CandidateSet: exact membership, insertion order, growth past the initial table, no hash-only matches
+static void test_candidate_set() {
+    CandidateSet set(4);
+    CHECK(set.insert("summer"));
+    CHECK(!set.insert("summer"));
+    CHECK(set.insert("Summer"));
+    CHECK(!set.insert("")); // Empty candidates are rejected
+    for (int i = 0; i < 10000; ++i) CHECK(set.insert("word" + std::to_string(i)));
+    CHECK(set.size() == 10002);
+    CHECK(set.contains("word9999", 8));
+    CHECK(!set.contains("word10000", 9));
+    CHECK(std::string(set.arena_data(), 14) == "summer\nSummer\n");
+
+    // Short strings once collided when only the high bits carried differences
+    CHECK(hash_bytes("welcomeJone#", 12) != hash_bytes("welcomejones", 12));
+    CandidateSet pair;
+    CHECK(pair.insert("welcomeJone#") && pair.insert("welcomejones"));
+}
+
+// parse_size: suffixes are powers of 1024, and anything that would wrap is rejected
+static void test_parse_size() {
+    size_t value = 0;
+    CHECK(parse_size("65536", value) && value == 65536);
+    CHECK(parse_size("64K", value) && value == 64 << 10);
+    CHECK(parse_size("4m", value) && value == 4 << 20);
+    CHECK(parse_size("2G", value) && value == static_cast<size_t>(2) << 30);
+    value = 7;
+    CHECK(!parse_size("", value) && !parse_size("0", value) && !parse_size("0K", value));
+    CHECK(!parse_size("-1", value) && !parse_size("+1", value) && !parse_size(" 1", value));
+    CHECK(!parse_size("4MB", value) && !parse_size("4 M", value) && !parse_size("1.5G", value));
+    CHECK(!parse_size("18446744073709551616", value)); // 2^64
+    CHECK(value == 7); // Rejected text leaves the value alone
+    if (sizeof(size_t) == 8) {
+        CHECK(parse_size("1T", value) && value == static_cast<size_t>(1) << 40);
+        CHECK(parse_size("18446744073709551615", value) && value == SIZE_MAX);
+        CHECK(parse_size("16777215T", value) && value == static_cast<size_t>(16777215) << 40);
+        CHECK(!parse_size("16777216T", value)); // 2^64: once wrapped to 0
+        CHECK(!parse_size("17179869185G", value)); // Once wrapped to 1G
+        CHECK(!parse_size("18014398509481985K", value));
+    } else {
+        CHECK(parse_size("3G", value) && value == static_cast<size_t>(3) << 30);
+        CHECK(!parse_size("4G", value) && !parse_size("1T", value));
+    }
+}
+
+/** @brief Compiles one rule into a fresh set and runs it; "<rejected>" if it rejects, "<error>" if it does not compile. */
+static std::string apply_rule(const std::string& rule, const std::string& word) {
+    RuleSet rules;
+    std::string error;
+    if (!rules.add(rule, error)) return "<error>";
+    char out[RuleSet::k_buffer_size];
+    const int size = rules.apply(0, word.data(), word.size(), out);
+    return size < 0 ? "<rejected>" : std::string(out, static_cast<size_t>(size));
+}
+
+// RuleSet: hashcat semantics of the compiled functions, rejections and parse errors
+static void test_rules() {
+    CHECK(apply_rule(":", "password") == "password");
+    CHECK(apply_rule("c $1 $2", "password") == "Password12");
+    CHECK(apply_rule("u", "Pass1") == "PASS1");
+    CHECK(apply_rule("C", "password") == "pASSWORD");
+    CHECK(apply_rule("t", "PassWord") == "pASSwORD");
+    CHECK(apply_rule("T0", "password") == "Password");
+    CHECK(apply_rule("r", "password") == "drowssap");
+    CHECK(apply_rule("d", "abc") == "abcabc");
+    CHECK(apply_rule("f", "abc") == "abccba");
+    CHECK(apply_rule("p2", "ab") == "ababab");
+    CHECK(apply_rule("{", "abc") == "bca");
+    CHECK(apply_rule("}", "abc") == "cab");
+    CHECK(apply_rule("[ ]", "abcd") == "bc");
+    CHECK(apply_rule("^1", "abc") == "1abc");
+    CHECK(apply_rule("D3", "password") == "pasword");
+    CHECK(apply_rule("x12", "password") == "as");
+    CHECK(apply_rule("O12", "password") == "psword");
+    CHECK(apply_rule("x08", "password") == "password");
+    CHECK(apply_rule("x59", "password") == "password"); // Out of range: unchanged, not clamped to "ord"
+    CHECK(apply_rule("x80", "password") == "password");
+    CHECK(apply_rule("O44", "password") == "pass");
+    CHECK(apply_rule("O59", "password") == "password"); // Out of range: unchanged, not clamped to "passw"
+    CHECK(apply_rule("O90", "password") == "password");
+    CHECK(apply_rule("i4!", "password") == "pass!word");
+    CHECK(apply_rule("o0P", "password") == "Password");
+    CHECK(apply_rule("'4", "password") == "pass");
+    CHECK(apply_rule("sa@ so0", "password") == "p@ssw0rd");
+    CHECK(apply_rule("@s", "password") == "paword");
+    CHECK(apply_rule("z2", "abc") == "aaabc");
+    CHECK(apply_rule("Z2", "abc") == "abccc");
+    CHECK(apply_rule("q", "abc") == "aabbcc");
+    CHECK(apply_rule("k", "abc") == "bac");
+    CHECK(apply_rule("K", "abc") == "acb");
+    CHECK(apply_rule("*02", "abc") == "cba");
+    CHECK(apply_rule("+0", "abc") == "bbc");
+    CHECK(apply_rule("-1", "abc") == "aac");
+    CHECK(apply_rule("E", "hello big world") == "Hello Big World");
+    CHECK(apply_rule("e-", "hello-big-world") == "Hello-Big-World");
+    CHECK(apply_rule("TA", "password") == "password"); // Positions past the end leave the word alone
+    CHECK(apply_rule("$a $b $c $d $e $f $g $h $i $j $k $l $m $n $o $p $q", std::string(240, 'x')) == "<rejected>");
+
+    // <N rejects words longer than N, >N words shorter than N (JtR's < and > are strict instead)
+    CHECK(apply_rule("<8", "password") == "password");
+    CHECK(apply_rule("<7", "password") == "<rejected>");
+    CHECK(apply_rule(">8", "password") == "password");
+    CHECK(apply_rule(">9", "password") == "<rejected>");
+    CHECK(apply_rule("_8", "password") == "password");
+    CHECK(apply_rule("!w", "password") == "<rejected>");
+    CHECK(apply_rule("/z", "password") == "<rejected>");
+    CHECK(apply_rule("(p )d", "password") == "password");
+    CHECK(apply_rule("=0q", "password") == "<rejected>");
+    CHECK(apply_rule("%2s", "password") == "password");
+    CHECK(apply_rule("%3s", "password") == "<rejected>");
+
+    CHECK(apply_rule("Q", "password") == "<error>");  // Unsupported function
+    CHECK(apply_rule("c $", "password") == "<error>"); // Missing character
+    CHECK(apply_rule("T!", "password") == "<error>"); // Not a position
+    CHECK(apply_rule("x1", "password") == "<error>"); // Missing second position
+
+    // A rule that fails to compile leaves the set as it was
+    RuleSet rules;
+    std::string error;
+    CHECK(rules.add("$1", error) && !rules.add("c Q", error) && rules.add("$2", error));
+    CHECK(error == "unsupported rule function 'Q'");
+    CHECK(rules.size() == 2);
+    char out[RuleSet::k_buffer_size];
+    CHECK(rules.apply(1, "a", 1, out) == 2 && std::string(out, 2) == "a2");
+
+    const std::string path = write_temp_file("rules.txt", "# comment\n:\nc\nQ\n\nr\n");
+    RuleSet loaded;
+    CHECK(loaded.load(path));
+    CHECK(loaded.size() == 3);
+    std::remove(path.c_str());
+}
+
+// LeetTable::load: "X Y" lines only; '#' lines are comments, not mappings from '#'
+static void test_leet_table() {
+    const std::string path = write_temp_file("leet_table.txt", "# x\n#comment\ne 3\na\t#\n\nbad line\n");
+    LeetTable table;
+    CHECK(table.load(path));
+    char text[] = "#tea";
+    CHECK(table.translate(text, text, 4));
+    CHECK(std::string(text) == "#t3#");
+    CHECK(!table.load(write_temp_file("leet_table.txt", "# only comments\n# x\n")));
+    std::remove(path.c_str());
+}
+
+// LeetTable variants: every non-empty substitution mask once, fully substituted first, random access in the same order
+static void test_leet_variants() {
+    const LeetTable table = LeetTable::defaults();
+    char word[] = "pass";
+    std::vector<std::string> variants;
+    CHECK(table.for_each_variant(word, 4, 100, [&]() { variants.push_back(std::string(word, 4)); }) == 7);
+    CHECK(std::string(word) == "pass"); // Restored
+    CHECK(variants.size() == 7 && variants[0] == "p@$$");
+    const std::set<std::string> expected = {"p@ss", "pa$s", "pas$", "p@$s", "p@s$", "pa$$", "p@$$"};
+    CHECK(std::set<std::string>(variants.begin(), variants.end()) == expected);
+    for (size_t v = 1; v <= variants.size(); ++v) {
+        char patched[] = "pass";
+        CHECK(table.variant_at(patched, 4, v) && variants[v - 1] == patched);
+    }
+    char patched[] = "pass";
+    CHECK(!table.variant_at(patched, 4, 8) && !table.variant_at(patched, 4, 0));
+    CHECK(std::string(patched) == "pass");
+
+    // The cap keeps the first variants of the sequence
+    std::vector<std::string> capped;
+    CHECK(table.for_each_variant(word, 4, 3, [&]() { capped.push_back(std::string(word, 4)); }) == 3);
+    CHECK(capped.size() == 3 && std::equal(capped.begin(), capped.end(), variants.begin()));
+    char plain[] = "xyz";
+    CHECK(table.for_each_variant(plain, 3, 100, []() {}) == 0 && !table.variant_at(plain, 3, 1));
+
+    // Twelve positions: 4095 distinct variants
+    char long_word[] = "aaaaeeeessss";
+    std::set<std::string> distinct;
+    CHECK(table.for_each_variant(long_word, 12, 1 << 20, [&]() { distinct.insert(std::string(long_word, 12)); }) == 4095);
+    CHECK(distinct.size() == 4095 && distinct.count("aaaaeeeessss") == 0);
+}
+
+/** @brief Collects every candidate it receives. */
+class CollectSink : public CandidateSink {
+public:
+    void emit(StringView candidate) override { candidates.push_back(std::string(candidate.data(), candidate.size())); }
+    std::vector<std::string> candidates;
+};
+
+/** @brief StringViews over a list of strings (which must outlive them). */
+static std::vector<StringView> views(const std::vector<std::string>& strings) {
+    std::vector<StringView> result;
+    for (const std::string& s : strings) result.push_back(StringView(s.data(), s.size()));
+    return result;
+}
+
+// Keyspace: index order is the streaming order, holes included, and any [skip, skip + limit) is a slice of it
+static void test_keyspace() {
+    const std::vector<std::string> base_storage = {"summer", "Dragon", "abc", "x1"};
+    const std::vector<std::string> info_storage = {"john", "2024"};
+    const std::vector<StringView> bases = views(base_storage);
+    const std::vector<StringView> infos = views(info_storage);
+    CombinatorConfig config;
+    config.suffixes = {"1", "!"};
+    config.case_forms = {CASE_CAPITALIZED, CASE_UPPER};
+    const LeetTable leet = LeetTable::defaults();
+    RuleSet rules;
+    std::string error;
+    CHECK(rules.add(":", error) && rules.add("$9", error) && rules.add("<9", error)); // <9 rejects candidates over 9 characters
+    TransformConfig transforms;
+    transforms.leet = &leet;
+    transforms.leet_max_variants = 3;
+    transforms.rules = &rules;
+
+    CollectSink streamed;
+    TransformChain chain(transforms, streamed);
+    generate_target_combinations(bases.data(), bases.data() + bases.size(), infos, config, chain.input());
+
+    const Keyspace keyspace(bases, infos, config, transforms);
+    // W = 1 + infos * (2 + 4F + suffixes * (4 + 4F)) + suffixes * (1 + F), L = 1 + 3, R = 3
+    CHECK(keyspace.slots() == 1 + 2 * (2 + 8 + 2 * (4 + 8)) + 2 * 3);
+    CHECK(keyspace.size() == 4 * keyspace.slots() * 4 * 3);
+    CHECK(keyspace.positions_per_base() == keyspace.slots() * 12);
+
+    KeyspaceCursor cursor(keyspace);
+    std::vector<std::string> decoded;
+    std::vector<uint64_t> indices; // Keyspace position of decoded[i]
+    StringView candidate;
+    for (uint64_t index = 0; index < keyspace.size(); ++index) {
+        if (!cursor.at(index, candidate)) continue;
+        decoded.push_back(std::string(candidate.data(), candidate.size()));
+        indices.push_back(index);
+    }
+    CHECK(decoded == streamed.candidates);
+    CHECK(decoded.size() > keyspace.size() / 4 && decoded.size() < keyspace.size()); // Mostly filled, with holes
+
+    // Random access: decoding a position after a jump gives the same candidate
+    for (size_t i = decoded.size(); i-- > 0;) {
+        CHECK(cursor.at(indices[i], candidate) && std::string(candidate.data(), candidate.size()) == decoded[i]);
+    }
+    const uint64_t probes[] = {0, 1, keyspace.positions_per_base() - 1, keyspace.positions_per_base(),
+                               keyspace.size() / 2, keyspace.size() - 1};
+    for (uint64_t probe : probes) {
+        const bool hole = std::find(indices.begin(), indices.end(), probe) == indices.end();
+        CHECK(cursor.at(probe, candidate) == !hole);
+    }
+
+    // --skip N --limit M: for_each over [N, N + M) is the slice of the full sequence
+    const uint64_t skips[] = {0, 7, keyspace.positions_per_base() - 1, keyspace.size() - 5};
+    for (uint64_t skip : skips) {
+        const uint64_t last = std::min(keyspace.size(), skip + 1000);
+        std::vector<std::string> range;
+        const uint64_t count = cursor.for_each(skip, last, [&](StringView c) { range.push_back(std::string(c.data(), c.size())); });
+        const size_t begin = std::lower_bound(indices.begin(), indices.end(), skip) - indices.begin();
+        const size_t end = std::lower_bound(indices.begin(), indices.end(), last) - indices.begin();
+        CHECK(count == end - begin && range.size() == count);
+        CHECK(std::equal(range.begin(), range.end(), decoded.begin() + begin));
+    }
+    CHECK(cursor.for_each(keyspace.size(), keyspace.size(), [](StringView) {}) == 0);
+
+    // 1 + leet_max_variants once wrapped to a width of 0 and an empty keyspace
+    TransformConfig wrapping = transforms;
+    wrapping.leet_max_variants = SIZE_MAX;
+    const Keyspace wrapped(bases, infos, config, wrapping);
+    CHECK(wrapped.overflow() && wrapped.size() == 0);
+}
+
+// OutputWriter: SIGINT ends a write blocked on a pipe nobody reads, with the delivered bytes counted
+static void test_output_interrupt() {
+    int fds[2];
+    CHECK(::pipe(fds) == 0);
+    install_stop_handler(SIGINT);
+    const pthread_t writer_thread = pthread_self();
+    std::thread interrupter([writer_thread]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        pthread_kill(writer_thread, SIGINT);
+    });
+    const std::string block(static_cast<size_t>(4) << 20, 'x'); // Far more than the pipe holds
+    {
+        OutputWriter writer(1 << 16, fds[1]);
+        writer.write_block(block.data(), block.size());
+        CHECK(g_stop_requested);
+        CHECK(!writer.ok());
+        CHECK(writer.bytes_written() > 0 && writer.bytes_written() < block.size());
+    }
+    interrupter.join();
+    std::signal(SIGINT, SIG_DFL);
+    g_stop_requested = 0;
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// mul_high64: the portable split multiply agrees with the native one, carries included
+static void test_mul_high64() {
+    CHECK(mul_high64_split(0, ~0ULL) == 0);
+    CHECK(mul_high64_split(~0ULL, ~0ULL) == ~0ULL - 1);
+    CHECK(mul_high64_split(1ULL << 32, 1ULL << 32) == 1);
+    CHECK(mul_high64_split(0xFFFFFFFFULL, 0xFFFFFFFFULL) == 0); // Largest middle column without a carry out
+    CHECK(mul_high64_split(0x1FFFFFFFFULL, 0xFFFFFFFF80000000ULL) == 0x1FFFFFFFEULL);
+    uint64_t state = 1;
+    for (int i = 0; i < 100000; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t a = state ^ (state >> 29);
+        const uint64_t b = (state << 17 | state >> 47) >> (i % 64);
+        CHECK(mul_high64_split(a, b) == mul_high64(a, b));
+    }
+    // Range reduction stays in range
+    for (uint64_t n : {1ULL, 3ULL, 1000ULL, 1ULL << 40}) CHECK(mul_high64(~0ULL, n) == n - 1);
+}
+
+/** @brief hash_bytes() of a string: the key an exclusion entry is stored under. */
+static uint64_t key_of(const std::string& s) { return hash_bytes(s.data(), s.size()); }
+
+// XorFilter and load_exclusions: no false negatives, about 2^-16 false positives, potfile plaintexts decoded
+static void test_exclusions() {
+    XorFilter empty;
+    CHECK(!empty.contains(0) && !empty.contains(key_of("summer")));
+
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 100000; ++i) keys.push_back(key_of("word" + std::to_string(i)));
+    keys.push_back(keys[0]); // Duplicates are allowed
+    XorFilter filter;
+    filter.build(keys);
+    CHECK(keys.size() == 100000);
+    size_t missing = 0;
+    for (uint64_t i = 0; i < 100000; ++i) missing += !filter.contains(key_of("word" + std::to_string(i)));
+    CHECK(missing == 0);
+    size_t false_positives = 0;
+    for (uint64_t i = 0; i < 1000000; ++i) false_positives += filter.contains(key_of("other" + std::to_string(i)));
+    CHECK(false_positives < 100); // About 15 expected
+    CHECK(filter.memory() < 100000 * 3); // Under 24 bits per key
+
+    // A potfile: plaintext after the last ':', $HEX[...] decoded, malformed $HEX[...] taken literally
+    const std::string potfile = write_temp_file("exclude.pot",
+        "5f4dcc3b5aa765d61d8327deb882cf99:password\n"
+        "hash:with:colons:Summer:2024\n"
+        "abc:$HEX[77696e746572]\n"
+        "abc:$HEX[4g]\n"
+        "abc:$HEX[414]\n"
+        "no colon here\n");
+    std::vector<uint64_t> pot_keys;
+    CHECK(load_exclusions(potfile, pot_keys));
+    CHECK(pot_keys.size() == 5);
+    XorFilter pot;
+    pot.build(pot_keys);
+    CHECK(pot.contains(key_of("password")) && pot.contains(key_of("2024")) && pot.contains(key_of("winter")));
+    CHECK(pot.contains(key_of("$HEX[4g]")) && pot.contains(key_of("$HEX[414]")));
+    CHECK(!pot.contains(key_of("Summer:2024")) && !pot.contains(key_of("no colon here")));
+
+    // A plain wordlist keeps whole lines; a missing file is an error
+    const std::string wordlist = write_temp_file("exclude.txt", "hash:plain\n$HEX[41]\n");
+    std::vector<uint64_t> list_keys;
+    CHECK(load_exclusions(wordlist, list_keys));
+    CHECK(list_keys.size() == 2 && list_keys[0] == key_of("hash:plain") && list_keys[1] == key_of("$HEX[41]"));
+    CHECK(!load_exclusions(temp_path("does_not_exist.txt"), list_keys));
+    std::remove(potfile.c_str());
+    std::remove(wordlist.c_str());
+}
+
+// ProbabilityOrder: every keyspace position exactly once, scores never increasing, each the sum of its dimensions
+static void test_probability_order() {
+    const std::vector<std::string> base_storage = {"summer", "dragon", "monkey", "abc", "x"};
+    const std::vector<std::string> info_storage = {"john", "acme"};
+    const std::vector<StringView> bases = views(base_storage);
+    const std::vector<StringView> infos = views(info_storage);
+    CombinatorConfig config;
+    config.suffixes = {"2024", "!", "1"};
+    config.case_forms = {CASE_CAPITALIZED, CASE_UPPER};
+    const LeetTable leet = LeetTable::defaults();
+    RuleSet rules;
+    std::string error;
+    CHECK(rules.add(":", error) && rules.add("$1", error) && rules.add("r", error));
+    TransformConfig transforms;
+    transforms.leet = &leet;
+    transforms.leet_max_variants = 4;
+    transforms.rules = &rules;
+    const Keyspace keyspace(bases, infos, config, transforms);
+    const ScoreModel model;
+
+    ProbabilityOrder order(keyspace, model, config);
+    std::vector<bool> seen(static_cast<size_t>(keyspace.size()), false);
+    uint64_t produced = 0;
+    uint64_t position = 0;
+    double score = 0;
+    double previous = std::numeric_limits<double>::infinity();
+    size_t max_frontier = 0;
+    const uint64_t per_base = keyspace.positions_per_base();
+    while (order.next(position, score)) {
+        CHECK(position < keyspace.size());
+        if (position >= keyspace.size()) break;
+        CHECK(!seen[position]);
+        seen[position] = true;
+        ++produced;
+        CHECK(score <= previous);
+        previous = score;
+        max_frontier = std::max(max_frontier, order.frontier());
+
+        const size_t base = static_cast<size_t>(position / per_base);
+        const uint64_t slot = position % per_base / (keyspace.leet_width() * keyspace.rule_width());
+        const uint64_t variant = position % (keyspace.leet_width() * keyspace.rule_width()) / keyspace.rule_width();
+        const uint64_t rule = position % keyspace.rule_width();
+        const double expected = model.base_score(base, bases[base]) +
+                                model.slot_score(keyspace.describe_slot(slot), config) +
+                                model.leet_score(variant) + model.rule_score(rule);
+        CHECK(std::fabs(score - expected) < 1e-9);
+    }
+    CHECK(produced == keyspace.size());
+    CHECK(max_frontier < keyspace.size() / 4); // The frontier, not the keyspace, is held in memory
+
+    // Dimensions too large to sort are reported instead of allocated
+    CHECK(ProbabilityOrder::oversized_dimension(keyspace) == nullptr);
+    TransformConfig wide = transforms;
+    wide.leet_max_variants = static_cast<size_t>(ProbabilityOrder::k_max_dimension);
+    CHECK(ProbabilityOrder::oversized_dimension(Keyspace(bases, infos, config, wide)) != nullptr);
+
+    // No base words: nothing to produce
+    const Keyspace none(std::vector<StringView>(), infos, config, transforms);
+    ProbabilityOrder empty(none, model, config);
+    CHECK(!empty.next(position, score));
+}
+
+/** @brief A CGPCFG01 file with one structure (D2) and the given groups, each "class, length, u32 terminals, counts, text". */
+static std::string pcfg_file(uint32_t group_count, const std::string& groups) {
+    std::string file(PcfgGrammar::k_magic, sizeof(PcfgGrammar::k_magic));
+    file += std::string("\x01\x00\x00\x00", 4);                          // One structure
+    file += std::string("\x01\x00\x00\x00\x01", 5);                      // Seen once, one run
+    file += std::string(1, PcfgGrammar::CLASS_DIGIT) + std::string(1, 2); // of two digits
+    for (int shift = 0; shift < 32; shift += 8) file.push_back(static_cast<char>(group_count >> shift));
+    return file + groups;
+}
+
+/** @brief One group of a CGPCFG01 file whose terminals are all seen once. */
+static std::string pcfg_group(uint8_t symbol_class, uint8_t length, uint32_t terminals, const std::string& text) {
+    std::string group(1, static_cast<char>(symbol_class));
+    group.push_back(static_cast<char>(length));
+    group += std::string(1, static_cast<char>(terminals)) + std::string(3, '\0');
+    for (uint32_t i = 0; i < terminals; ++i) group += std::string("\x01\x00\x00\x00", 4);
+    return group + text;
+}
+
+// PcfgGrammar: save() and load() round-trip, and load() rejects malformed grammars
+static void test_pcfg_format() {
+    const std::string training = write_temp_file("pcfg_train.txt",
+        "Summer2024!\nsummer2024\nWinter2023!\ndragon12\npassword1\nPassword1\n12345678\nabc!!\n");
+    PcfgGrammar trained;
+    CHECK(trained.train(training));
+    const std::string saved = temp_path("pcfg_saved.pcfg");
+    CHECK(trained.save(saved));
+
+    PcfgGrammar loaded;
+    CHECK(loaded.load(saved));
+    CHECK(loaded.structure_total() == 8);
+    CHECK(loaded.structure_total() == trained.structure_total());
+    CHECK(loaded.structures().size() == trained.structures().size());
+    for (size_t i = 0; i < trained.structures().size() && i < loaded.structures().size(); ++i) {
+        const PcfgGrammar::Structure& a = trained.structures()[i];
+        const PcfgGrammar::Structure& b = loaded.structures()[i];
+        CHECK(a.count == b.count && a.segments.size() == b.segments.size());
+        for (size_t s = 0; s < a.segments.size() && s < b.segments.size(); ++s) {
+            CHECK(a.segments[s].symbol_class == b.segments[s].symbol_class);
+            CHECK(a.segments[s].length == b.segments[s].length);
+        }
+    }
+    CHECK(loaded.terminal_count() == trained.terminal_count());
+    for (uint8_t symbol_class = 0; symbol_class < PcfgGrammar::CLASS_COUNT; ++symbol_class) {
+        for (unsigned length = 1; length < 256; ++length) {
+            const PcfgGrammar::Group* a = trained.group(symbol_class, static_cast<uint8_t>(length));
+            const PcfgGrammar::Group* b = loaded.group(symbol_class, static_cast<uint8_t>(length));
+            CHECK((a == nullptr) == (b == nullptr));
+            if (a == nullptr || b == nullptr) continue;
+            CHECK(a->counts == b->counts && a->terminals == b->terminals && a->total == b->total);
+        }
+    }
+    const PcfgGrammar::Group* digits = loaded.group(PcfgGrammar::CLASS_DIGIT, 4);
+    CHECK(digits != nullptr && digits->size() == 2 && std::string(digits->terminal(0).data(), 4) == "2024");
+    const std::string resaved = temp_path("pcfg_resaved.pcfg");
+    CHECK(loaded.save(resaved));
+    CHECK(read_file(resaved) == read_file(saved));
+
+    // A minimal valid file, then the same file with one defect each
+    const std::string digit_group = pcfg_group(PcfgGrammar::CLASS_DIGIT, 2, 2, "1207");
+    const std::string valid = pcfg_file(1, digit_group);
+    PcfgGrammar grammar;
+    CHECK(grammar.load(write_temp_file("pcfg_valid.pcfg", valid)));
+    CHECK(!grammar.load(write_temp_file("pcfg_truncated.pcfg", valid.substr(0, valid.size() - 1))));
+    CHECK(!grammar.load(write_temp_file("pcfg_trailing.pcfg", valid + "0")));
+    CHECK(!grammar.load(write_temp_file("pcfg_duplicate.pcfg", pcfg_file(2, digit_group + digit_group))));
+    CHECK(!grammar.load(write_temp_file("pcfg_letter.pcfg", pcfg_file(1, pcfg_group(PcfgGrammar::CLASS_DIGIT, 2, 2, "12a7")))));
+    CHECK(!grammar.load(write_temp_file("pcfg_newline.pcfg", pcfg_file(1, pcfg_group(PcfgGrammar::CLASS_DIGIT, 2, 2, "1\n07")))));
+    CHECK(!grammar.load(write_temp_file("pcfg_control.pcfg", pcfg_file(1, pcfg_group(PcfgGrammar::CLASS_SYMBOL, 2, 1, "!\x01")))));
+    CHECK(!grammar.load(write_temp_file("pcfg_mask.pcfg", pcfg_file(1, pcfg_group(PcfgGrammar::CLASS_LETTER, 2, 1, "Ux")))));
+    // Terminals of three digits in a two-digit group: the count no longer matches the text
+    CHECK(!grammar.load(write_temp_file("pcfg_length.pcfg", pcfg_file(1, pcfg_group(PcfgGrammar::CLASS_DIGIT, 2, 2, "120")))));
+    const PcfgGrammar::Group* kept = grammar.group(PcfgGrammar::CLASS_DIGIT, 2); // Failed loads keep the last good grammar
+    CHECK(kept != nullptr && kept->terminals == "1207");
+
+    for (const char* name : {"pcfg_train.txt", "pcfg_saved.pcfg", "pcfg_resaved.pcfg", "pcfg_valid.pcfg",
+                             "pcfg_truncated.pcfg", "pcfg_trailing.pcfg", "pcfg_duplicate.pcfg", "pcfg_letter.pcfg",
+                             "pcfg_newline.pcfg", "pcfg_control.pcfg", "pcfg_mask.pcfg", "pcfg_length.pcfg"}) {
+        std::remove(temp_path(name).c_str());
+    }
+}
+
+/** @brief The first count strings of a Markov model, likeliest level first (as stream_markov() orders them). */
+static std::vector<std::string> markov_strings(const MarkovModel& model, unsigned max_level, size_t count) {
+    std::vector<std::string> strings;
+    for (unsigned level = 0; level <= max_level && strings.size() < count; ++level) {
+        for (size_t prefix = 0; prefix < model.prefix_count() && strings.size() < count; ++prefix) {
+            model.enumerate(level, prefix, [&](StringView s) {
+                strings.push_back(std::string(s.data(), s.size()));
+                return strings.size() < count;
+            });
+        }
+    }
+    return strings;
+}
+
+/** @brief A Markov training list: 1000 three-syllable words and 200 copies of "password". */
+static std::vector<std::string> markov_training_words() {
+    std::vector<std::string> storage;
+    const char* const syllables[] = {"pa", "ss", "wo", "rd", "dra", "gon", "sun", "shi", "ne", "key"};
+    for (int i = 0; i < 1000; ++i) {
+        storage.push_back(std::string(syllables[i % 10]) + syllables[(i / 10) % 10] + syllables[(i / 100) % 10]);
+    }
+    for (int i = 0; i < 200; ++i) storage.push_back("password");
+    return storage;
+}
+
+// MarkovModel: trained strings come first, and nothing is built from unseen n-grams
+static void test_markov_levels() {
+    // Many distinct words, so rare-but-seen events and the unseen ones once shared level 10
+    const std::vector<std::string> storage = markov_training_words();
+    const std::vector<StringView> words = views(storage);
+
+    const unsigned order = 3;
+    MarkovModel model(order);
+    CHECK(model.train(words, std::vector<StringView>(), static_cast<size_t>(64) << 20));
+    std::set<std::string> prefixes;
+    std::set<std::string> grams;
+    for (const std::string& word : storage) {
+        prefixes.insert(word.substr(0, order));
+        for (size_t i = 0; i + order < word.size(); ++i) grams.insert(word.substr(i, order + 1));
+    }
+
+    const std::vector<std::string> top = markov_strings(model, MarkovModel::k_max_level * 4, 50);
+    CHECK(top.size() == 50);
+    // A sixth of the training set: in the likeliest level, with the strings sharing its n-grams
+    const std::vector<std::string>::const_iterator likeliest = top.begin() + std::min<size_t>(top.size(), 3);
+    CHECK(std::find(top.begin(), likeliest, "password") != likeliest);
+    for (const std::string& s : top) {
+        CHECK(prefixes.count(s.substr(0, order)) == 1);
+        for (size_t i = 0; i + order < s.size(); ++i) CHECK(grams.count(s.substr(i, order + 1)) == 1);
+    }
+}
+
+/** @brief Runs stream_markov() into a file and returns the lines it wrote. */
+static std::vector<std::string> stream_markov_lines(const MarkovModel& model, unsigned max_level, unsigned threads,
+                                                    uint64_t limit, size_t& reported) {
+    const std::string path = temp_path("markov_out.txt");
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0);
+    {
+        OutputWriter writer(1 << 16, fd);
+        reported = stream_markov(model, max_level, threads, nullptr, limit, writer);
+    }
+    ::close(fd);
+    std::vector<std::string> lines;
+    std::istringstream text(read_file(path));
+    for (std::string line; std::getline(text, line);) lines.push_back(line);
+    std::remove(path.c_str());
+    return lines;
+}
+
+// stream_markov: --top N gives exactly the N likeliest strings, the same for any thread count
+static void test_markov_stream() {
+    const std::vector<std::string> storage = markov_training_words();
+    MarkovModel model(3);
+    CHECK(model.train(views(storage), std::vector<StringView>(), static_cast<size_t>(64) << 20));
+    const unsigned max_level = 40;
+
+    size_t reported = 0;
+    const std::vector<std::string> all = stream_markov_lines(model, max_level, 1, 0, reported);
+    CHECK(reported == all.size() && all.size() > 5000);
+    CHECK(std::set<std::string>(all.begin(), all.end()).size() == all.size()); // Distinct by construction
+    CHECK(all == markov_strings(model, max_level, all.size() + 1)); // Levels ascending, prefixes in order
+
+    for (unsigned threads : {2u, 3u, 8u}) {
+        CHECK(stream_markov_lines(model, max_level, threads, 0, reported) == all && reported == all.size());
+    }
+    for (uint64_t top : {1ULL, 37ULL, 4096ULL, static_cast<unsigned long long>(all.size())}) {
+        for (unsigned threads : {1u, 2u, 8u}) {
+            const std::vector<std::string> lines = stream_markov_lines(model, max_level, threads, top, reported);
+            CHECK(lines.size() == top && reported == top);
+            CHECK(std::equal(lines.begin(), lines.end(), all.begin()));
+        }
+    }
+    // A limit beyond the threshold's strings stops at the threshold
+    CHECK(stream_markov_lines(model, max_level, 4, all.size() + 10, reported).size() == all.size());
+}
+
+/** @brief Runs run_chunks_parallel() into a file: chunk c emits "c-i" for i < per_chunk. Returns the lines written. */
+static std::vector<std::string> run_chunk_lines(size_t chunks, size_t per_chunk, unsigned threads, uint64_t limit,
+                                                std::atomic<uint64_t>& produced) {
+    const std::string path = temp_path("chunks_out.txt");
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0);
+    {
+        OutputWriter writer(1 << 16, fd);
+        run_chunks_parallel(chunks, threads, true, 0, writer, [&](size_t chunk, CandidateSink& sink, const ChunkLimit& limit_reached) {
+            for (size_t i = 0; i < per_chunk && !limit_reached(); ++i) {
+                sink.emit(std::to_string(chunk) + "-" + std::to_string(i));
+                ++produced;
+            }
+        }, limit);
+    }
+    ::close(fd);
+    std::vector<std::string> lines;
+    std::istringstream text(read_file(path));
+    for (std::string line; std::getline(text, line);) lines.push_back(line);
+    std::remove(path.c_str());
+    return lines;
+}
+
+// run_chunks_parallel: chunks far larger than a piece stay in order, and a limit stops generation
+static void test_chunk_pieces() {
+    const size_t per_chunk = 300000; // About 3 MiB per chunk
+    std::vector<std::string> expected;
+    for (size_t chunk = 0; chunk < 4; ++chunk) {
+        for (size_t i = 0; i < per_chunk; ++i) expected.push_back(std::to_string(chunk) + "-" + std::to_string(i));
+    }
+    std::atomic<uint64_t> produced(0);
+    CHECK(run_chunk_lines(4, per_chunk, 4, 0, produced) == expected);
+    CHECK(produced == expected.size());
+
+    produced = 0;
+    const std::vector<std::string> top = run_chunk_lines(4, per_chunk, 4, per_chunk + 1000, produced);
+    CHECK(top.size() == per_chunk + 1000 && std::equal(top.begin(), top.end(), expected.begin()));
+    // Chunk 0, then at most one 1 MiB piece (about 129000 of these lines) per other chunk
+    CHECK(produced < per_chunk + 3 * 140000); // Without the stop: 4 * per_chunk
+}
+
+// --- Test Runner ---
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+static const TestCase k_tests[] = {
+    {"candidate_set", test_candidate_set},
+    {"parse_size", test_parse_size},
+    {"rules", test_rules},
+    {"leet_table", test_leet_table},
+    {"leet_variants", test_leet_variants},
+    {"keyspace", test_keyspace},
+    {"output_interrupt", test_output_interrupt},
+    {"mul_high64", test_mul_high64},
+    {"exclusions", test_exclusions},
+    {"probability_order", test_probability_order},
+    {"pcfg_format", test_pcfg_format},
+    {"markov_levels", test_markov_levels},
+    {"markov_stream", test_markov_stream},
+    {"chunk_pieces", test_chunk_pieces},
+};
+
+int main(int argc, char* argv[]) {
+    int ran = 0;
+    for (const TestCase& test : k_tests) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) selected = selected || std::strcmp(argv[i], test.name) == 0;
+        if (!selected) continue;
+        const int failures_before = g_failures;
+        test.run();
+        std::cerr << (g_failures == failures_before ? "[ OK ] " : "[FAIL] ") << test.name << std::endl;
+        ++ran;
+    }
+    if (ran == 0) {
+        std::cerr << "No test matches the given names." << std::endl;
+        return 1;
+    }
+    return g_failures == 0 ? 0 : 1;
+}